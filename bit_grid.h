@@ -0,0 +1,158 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_buffer.h"
+
+// Row-major grid of bits in one contiguous block, each row padded to whole 32-bit words.
+// Padding bits are always clear so rows can be combined word by word.
+// Dimensions are either both fixed at compile time or both DynamicSize.
+template <int Width = DynamicSize, int Height = DynamicSize>
+class BitGrid
+{
+public:
+  static const int WordBits = 32;
+  static constexpr int WordsPerRow = (Width + WordBits - 1) / WordBits;
+  static constexpr int WordCount = WordsPerRow * Height; // DynamicSize for runtime sized grids
+
+private:
+  int _width;
+  int _height;
+  int _wordsPerRow;
+  MazeBuffer<uint32_t, WordCount> _words;
+
+public:
+  BitGrid(int width = Width, int height = Height);
+
+  int width() const { return Width != DynamicSize ? Width : _width; }
+  int height() const { return Height != DynamicSize ? Height : _height; }
+  int wordsPerRow() const { return Width != DynamicSize ? WordsPerRow : _wordsPerRow; }
+  int sizeInBytes() const { return wordsPerRow() * height() * sizeof(uint32_t); }
+  uint32_t *row(int y) { return _words.data() + y * wordsPerRow(); }
+  const uint32_t *row(int y) const { return _words.data() + y * wordsPerRow(); }
+
+  bool get(int x, int y) const { return (row(y)[x / WordBits] >> (x % WordBits)) & 1; }
+  void set(int x, int y, bool value);
+  void fill(bool value);
+  void clearRow(int y) { memset(row(y), 0, wordsPerRow() * sizeof(uint32_t)); }
+  // exchanges contents with a grid of the same dimensions, O(1) for runtime sized grids
+  void swap(BitGrid &other) { _words.swap(other._words); }
+
+  uint32_t getRowWindow(int x, int y) const;
+  int getAdjacentSetOrBorderCount(int x, int y) const;
+  void getDilatedRow(int y, uint32_t *out) const;
+
+  // mask of the valid bits in word w of a row
+  uint32_t wordMask(int w) const;
+};
+
+template <int Width, int Height>
+BitGrid<Width, Height>::BitGrid(int width, int height)
+{
+  _width = width;
+  _height = height;
+  _wordsPerRow = (width + WordBits - 1) / WordBits;
+  _words.allocate(_wordsPerRow * _height);
+}
+
+template <int Width, int Height>
+void BitGrid<Width, Height>::set(int x, int y, bool value)
+{
+  uint32_t bit = 1u << (x % WordBits);
+  uint32_t &word = row(y)[x / WordBits];
+  word = value ? (word | bit) : (word & ~bit);
+}
+
+template <int Width, int Height>
+void BitGrid<Width, Height>::fill(bool value)
+{
+  for (int y = 0; y < height(); y++)
+  {
+    uint32_t *words = row(y);
+    for (int w = 0; w < wordsPerRow(); w++)
+    {
+      words[w] = value ? wordMask(w) : 0;
+    }
+  }
+}
+
+template <int Width, int Height>
+uint32_t BitGrid<Width, Height>::wordMask(int w) const
+{
+  int bits = width() - w * WordBits;
+  return bits >= WordBits ? 0xFFFFFFFF : (1u << bits) - 1;
+}
+
+// bits for columns x-1, x and x+1 of row y (bit 0 is x-1), anything outside the grid reads as set
+template <int Width, int Height>
+uint32_t BitGrid<Width, Height>::getRowWindow(int x, int y) const
+{
+  if (y < 0 || y >= height())
+  {
+    return 0b111;
+  }
+
+  const uint32_t *words = row(y);
+  uint64_t bits;
+  if (x == 0)
+  {
+    bits = ((uint64_t)words[0] << 1) | 1;
+  }
+  else
+  {
+    int w = (x - 1) / WordBits;
+    uint64_t pair = words[w];
+    if (w + 1 < wordsPerRow())
+    {
+      pair |= (uint64_t)words[w + 1] << WordBits;
+    }
+    bits = pair >> ((x - 1) % WordBits);
+  }
+
+  if (x + 1 >= width())
+  {
+    bits |= 0b100;
+  }
+
+  return bits & 0b111;
+}
+
+// number of set 4-neighbors of (x,y), counting the grid border as set
+template <int Width, int Height>
+int BitGrid<Width, Height>::getAdjacentSetOrBorderCount(int x, int y) const
+{
+  uint32_t horizontal = getRowWindow(x, y) & 0b101;
+  uint32_t up = getRowWindow(x, y - 1) & 0b010;
+  uint32_t down = getRowWindow(x, y + 1) & 0b010;
+  return __builtin_popcount(horizontal | (up << 2) | (down << 3));
+}
+
+// row y with every set bit spread to its 4-neighbors, written to out, bits outside the grid are dropped
+template <int Width, int Height>
+void BitGrid<Width, Height>::getDilatedRow(int y, uint32_t *out) const
+{
+  const uint32_t *words = row(y);
+  const uint32_t *up = y > 0 ? row(y - 1) : nullptr;
+  const uint32_t *down = y + 1 < height() ? row(y + 1) : nullptr;
+  uint32_t carry = 0; // top bit of the previous word, shifted into bit 0
+  for (int w = 0; w < wordsPerRow(); w++)
+  {
+    uint32_t cur = words[w];
+    uint32_t bits = cur | (cur << 1) | (cur >> 1) | carry;
+    if (w + 1 < wordsPerRow())
+    {
+      bits |= words[w + 1] << (WordBits - 1);
+    }
+    if (up != nullptr)
+    {
+      bits |= up[w];
+    }
+    if (down != nullptr)
+    {
+      bits |= down[w];
+    }
+    carry = cur >> (WordBits - 1);
+    out[w] = bits;
+  }
+  out[wordsPerRow() - 1] &= wordMask(wordsPerRow() - 1);
+}
@@ -1,23 +1,69 @@
 #pragma once
 #include <Arduino.h>
 
+#include "spsc_queue.h"
+#include "text_layer.h"
+
+enum class DisplayCommandType : uint8_t
+{
+    Display,    // value: on if nonzero
+    Message,    // message
+    Brightness, // value: 0-255
+    Speed,      // value: ms per frame
+    Reseed,     // value: seed
+    Pause,
+    Resume,
+    TextMode    // value: TextMode
+};
+
+struct DisplayCommand
+{
+    static const int MaxMessageSize = 100;
+
+    DisplayCommandType type;
+    uint32_t value;
+    char message[MaxMessageSize];
+};
+
+// Control calls only queue a command, which the display task applies between frames, so they never
+// block the render loop and never change state in the middle of a frame. They may be called from one
+// other task at a time, and the try and bool ones return false if the queue is full.
 class DisplayTaskHandler
 {
 protected:
-    static const int MaxMessageSize = 100;
+    static const int MaxMessageSize = DisplayCommand::MaxMessageSize;
+    static const int CommandQueueSize = 8;
 
+    // only touched by the display task
     bool _display = true;
-    char _message[MaxMessageSize];
+    bool _paused = false;
+    char _message[MaxMessageSize] = "";
+    TextMode _textMode = TextMode::Overlay;
     TaskHandle_t _taskHandle = NULL;
 
+private:
+    SpscQueue<DisplayCommand, CommandQueueSize> _commands;
+    // only touched by the control task, so reading it never races the display task's copy
+    char _queuedMessage[MaxMessageSize] = "";
+
 public:
     virtual bool createTask() = 0;
 
-    char *getMessage() { return _message; }
+    // the message last queued by the control task, which the display task shows from its next frame
+    const char *getMessage() const { return _queuedMessage; }
 
-    virtual void setDisplay(bool displayState) { _display = displayState; }
-
-    virtual void setMessage(const char *message) { strncpy(_message, message, MaxMessageSize); }
+    // overrides that call these still apply the change, now by queueing it
+    virtual void setDisplay(bool displayState) { trySetDisplay(displayState); }
+    virtual void setMessage(const char *message) { trySetMessage(message); }
+    bool trySetDisplay(bool displayState) { return sendCommand(DisplayCommandType::Display, displayState); }
+    bool trySetMessage(const char *message);
+    bool setBrightness(uint8_t brightness) { return sendCommand(DisplayCommandType::Brightness, brightness); }
+    bool setSpeed(uint32_t frameMs) { return sendCommand(DisplayCommandType::Speed, frameMs); }
+    bool reseed(uint32_t seed) { return sendCommand(DisplayCommandType::Reseed, seed); }
+    bool pause() { return sendCommand(DisplayCommandType::Pause, 0); }
+    bool resume() { return sendCommand(DisplayCommandType::Resume, 0); }
+    // how the message is shown against whatever the task normally draws
+    bool setTextMode(TextMode mode) { return sendCommand(DisplayCommandType::TextMode, (uint32_t)mode); }
 
     bool suspendTask()
     {
@@ -32,9 +78,79 @@ public:
 protected:
     virtual void task(void *parameters) = 0;
 
+    // called by task() at frame boundaries, applies every queued command in order
+    void drainCommands()
+    {
+        DisplayCommand command;
+        while (_commands.pop(command))
+        {
+            applyCommand(command);
+        }
+    }
+
+    // subclasses handle the commands that need their hardware and pass the rest on
+    virtual void applyCommand(const DisplayCommand &command)
+    {
+        switch (command.type)
+        {
+        case DisplayCommandType::Display:
+            _display = command.value != 0;
+            break;
+        case DisplayCommandType::Message:
+            strncpy(_message, command.message, MaxMessageSize);
+            break;
+        case DisplayCommandType::Pause:
+            _paused = true;
+            break;
+        case DisplayCommandType::Resume:
+            _paused = false;
+            break;
+        case DisplayCommandType::TextMode:
+            _textMode = (TextMode)command.value;
+            break;
+        default:
+            break;
+        }
+    }
+
     static void taskWrapper(void *parameters)
     {
         DisplayTaskHandler *handler = static_cast<DisplayTaskHandler *>(parameters);
         handler->task(parameters);
     }
-};
\ No newline at end of file
+
+private:
+    bool sendCommand(DisplayCommandType type, uint32_t value)
+    {
+        DisplayCommand command;
+        command.type = type;
+        command.value = value;
+        command.message[0] = '\0';
+        return queueCommand(command);
+    }
+
+    bool queueCommand(const DisplayCommand &command)
+    {
+        if (!_commands.push(command))
+        {
+            log_w("Display command queue full, dropping command %d", (int)command.type);
+            return false;
+        }
+        return true;
+    }
+};
+
+bool DisplayTaskHandler::trySetMessage(const char *message)
+{
+    DisplayCommand command;
+    command.type = DisplayCommandType::Message;
+    command.value = 0;
+    strncpy(command.message, message, MaxMessageSize);
+    command.message[MaxMessageSize - 1] = '\0';
+    if (!queueCommand(command))
+    {
+        return false;
+    }
+    memcpy(_queuedMessage, command.message, MaxMessageSize);
+    return true;
+}
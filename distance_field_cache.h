@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_buffer.h"
+
+// Least recently used set of BFS distance maps, keyed by source cell index. A field covers every
+// cell reachable from its source, or only those within a radius. Cells it doesn't reach read as
+// Unreachable, so a field only writes the cells around its source: the owner erases those cells of
+// the field insert() evicts, then fills the new one, and clears the cache whenever the walls change.
+// Sizes are either both fixed at compile time or both DynamicSize.
+template <int CellCount = DynamicSize, int SlotCount = DynamicSize>
+class DistanceFieldCache
+{
+public:
+  static const uint16_t Unreachable = 0xFFFF;
+
+private:
+  int _cellCount;
+  int _slotCount;
+  MazeBuffer<uint16_t, CellCount * SlotCount> _fields; // _slotCount fields of _cellCount distances each
+  MazeBuffer<int, SlotCount> _sources;                  // source cell of each slot's field, -1 if empty
+  MazeBuffer<int, SlotCount> _radii;                    // steps each field reaches, 0 for all of the maze, -1 once stale
+  MazeBuffer<uint32_t, SlotCount> _lastUsed;            // use clock value of each slot's last lookup
+  uint32_t _useClock = 0;
+  uint32_t _hits = 0;
+  uint32_t _lookups = 0;
+
+public:
+  DistanceFieldCache(int cellCount = CellCount, int slotCount = SlotCount);
+
+  int slotCount() const { return _slotCount; }
+  uint32_t hits() const { return _hits; }
+  uint32_t lookups() const { return _lookups; }
+  const uint16_t *find(int source, int maxSteps);
+  uint16_t *insert(int source, int radius, int *evictedSource);
+  void clear();
+};
+
+template <int CellCount, int SlotCount>
+DistanceFieldCache<CellCount, SlotCount>::DistanceFieldCache(int cellCount, int slotCount)
+{
+  _cellCount = cellCount;
+  _slotCount = slotCount;
+  _fields.allocate(cellCount * slotCount);
+  _sources.allocate(slotCount);
+  _radii.allocate(slotCount);
+  _lastUsed.allocate(slotCount);
+  std::fill_n(_fields.data(), _fields.size(), Unreachable);
+  std::fill_n(_sources.data(), _sources.size(), -1);
+  clear();
+}
+
+// field for source if one reaching at least maxSteps is cached (0 or less for all of the maze), nullptr otherwise
+template <int CellCount, int SlotCount>
+const uint16_t *DistanceFieldCache<CellCount, SlotCount>::find(int source, int maxSteps)
+{
+  _lookups++;
+  for (int i = 0; i < _slotCount; i++)
+  {
+    if (_sources[i] == source && (_radii[i] == 0 || (maxSteps > 0 && maxSteps <= _radii[i])))
+    {
+      _hits++;
+      _lastUsed[i] = ++_useClock;
+      return _fields.data() + i * _cellCount;
+    }
+  }
+  return nullptr;
+}
+
+// claims the least recently used slot for a field reaching radius steps from source (0 for all of the
+// maze) and returns it to fill, after the owner erases the field of evictedSource if that isn't -1
+template <int CellCount, int SlotCount>
+uint16_t *DistanceFieldCache<CellCount, SlotCount>::insert(int source, int radius, int *evictedSource)
+{
+  int slot = 0;
+  for (int i = 1; i < _slotCount; i++)
+  {
+    if (_lastUsed[i] < _lastUsed[slot])
+    {
+      slot = i;
+    }
+  }
+
+  *evictedSource = _sources[slot];
+  _sources[slot] = source;
+  _radii[slot] = radius;
+  _lastUsed[slot] = ++_useClock;
+  return _fields.data() + slot * _cellCount;
+}
+
+template <int CellCount, int SlotCount>
+void DistanceFieldCache<CellCount, SlotCount>::clear()
+{
+  // the fields stay in place until their slots are reused, so the owner can still erase them
+  for (int i = 0; i < _slotCount; i++)
+  {
+    _radii[i] = -1;
+    _lastUsed[i] = 0;
+  }
+  _useClock = 0;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_buffer.h"
+
+// BFS distances and next-step directions toward a source cell, so any number of chasers can read
+// their next step in O(1). Directions index Left, Right, Up, Down, the order of Directions in
+// maze_runner_lib.h. When the source moves to an adjacent cell the field is repaired in place,
+// only touching the cells that got closer.
+// Size is either fixed at compile time or DynamicSize.
+template <int CellCount = DynamicSize>
+class FlowField
+{
+public:
+  static const uint8_t NoDirection = 0xFF;
+
+private:
+  static const int32_t Unreachable = INT32_MAX;
+  static const int32_t MaxBias = 1 << 30;
+
+  int _source = -1;
+  int32_t _bias = 0;                      // added to every stored distance, so all cells can grow by one at once
+  MazeBuffer<int32_t, CellCount> _dists;  // distance minus _bias, Unreachable if walled off
+  MazeBuffer<uint8_t, CellCount> _directions;
+
+public:
+  void allocate(int cellCount);
+
+  bool isValid() const { return _source >= 0; }
+  int source() const { return _source; }
+  void clear() { _source = -1; }
+
+  // steps from index to the source, -1 if unreachable
+  int distance(int index) const { return _dists[index] == Unreachable ? -1 : _dists[index] + _bias; }
+  // step toward the source from index, NoDirection at the source or if unreachable
+  uint8_t direction(int index) const { return _directions[index]; }
+
+  template <typename Grid>
+  void build(const Grid &walls, int source, int *queue);
+  template <typename Grid>
+  void moveSource(const Grid &walls, int source, int *queue);
+
+private:
+  template <typename Grid>
+  void relax(const Grid &walls, int queueTail, int *queue);
+};
+
+template <int CellCount>
+void FlowField<CellCount>::allocate(int cellCount)
+{
+  _dists.allocate(cellCount);
+  _directions.allocate(cellCount);
+}
+
+// full BFS from source, queue needs room for every cell
+template <int CellCount>
+template <typename Grid>
+void FlowField<CellCount>::build(const Grid &walls, int source, int *queue)
+{
+  int cellCount = walls.width() * walls.height();
+  for (int i = 0; i < cellCount; i++)
+  {
+    _dists[i] = Unreachable;
+    _directions[i] = NoDirection;
+  }
+
+  _source = source;
+  _bias = 0;
+  _dists[source] = 0;
+  queue[0] = source;
+  relax(walls, 1, queue);
+}
+
+// Moving the source one step changes every distance by at most one, so after raising them all by
+// one through _bias only cells now closer than that need a visit. Cells left alone keep a valid
+// direction, except the old source, which now points at the new one.
+template <int CellCount>
+template <typename Grid>
+void FlowField<CellCount>::moveSource(const Grid &walls, int source, int *queue)
+{
+  int width = walls.width();
+  int step = source - _source;
+  bool adjacent = ((step == 1 || step == -1) && source / width == _source / width) || step == width || step == -width;
+  if (!isValid() || !adjacent || _dists[source] == Unreachable || _bias >= MaxBias)
+  {
+    build(walls, source, queue);
+    return;
+  }
+
+  int oldSource = _source;
+  _directions[oldSource] = step == -1 ? 0 : step == 1 ? 1 : step == -width ? 2 : 3;
+
+  _bias++;
+  _source = source;
+  _dists[source] = -_bias;
+  _directions[source] = NoDirection;
+  queue[0] = source;
+  relax(walls, 1, queue);
+}
+
+// BFS from the queued cells, lowering any neighbor whose distance improves
+template <int CellCount>
+template <typename Grid>
+void FlowField<CellCount>::relax(const Grid &walls, int queueTail, int *queue)
+{
+  int width = walls.width();
+  int height = walls.height();
+  int queueHead = 0;
+  while (queueHead < queueTail)
+  {
+    int curIndex = queue[queueHead++];
+    int32_t nextDist = _dists[curIndex] + 1; // still biased
+    int x = curIndex % width;
+    int y = curIndex / width;
+
+    // neighbors in Directions order, each pointing back with the opposite direction
+    int neighbors[4] = {x > 0 ? curIndex - 1 : -1, x + 1 < width ? curIndex + 1 : -1,
+                        y > 0 ? curIndex - width : -1, y + 1 < height ? curIndex + width : -1};
+    for (int d = 0; d < 4; d++)
+    {
+      int nextIndex = neighbors[d];
+      if (nextIndex < 0 || walls.get(nextIndex % width, nextIndex / width) || _dists[nextIndex] <= nextDist)
+      {
+        continue;
+      }
+
+      _dists[nextIndex] = nextDist;
+      _directions[nextIndex] = d ^ 1;
+      queue[queueTail++] = nextIndex;
+    }
+  }
+}
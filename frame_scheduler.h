@@ -0,0 +1,81 @@
+#pragma once
+#include <Arduino.h>
+
+// Fixed timestep frame loop on absolute FreeRTOS wake times, so the period doesn't stretch by however
+// long a frame's update and show took. A frame that starts late first runs the simulation steps it
+// missed, up to MaxStepsPerFrame in all, and drops the rest of the backlog. A frame can also sleep
+// through steps the caller knows would change nothing.
+class FrameScheduler
+{
+public:
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t steps = 0;        // more than frames while catching up
+        uint32_t overruns = 0;     // frames whose work took longer than the period
+        uint32_t droppedSteps = 0; // missed steps beyond what a frame can catch up
+        uint32_t idleSteps = 0;    // steps slept through without waking
+        uint32_t maxWorkUs = 0;
+        uint64_t totalWorkUs = 0;
+    };
+
+private:
+    TickType_t _period;
+    uint32_t _periodUs;
+    int _maxStepsPerFrame;
+    TickType_t _wakeTime = 0; // when the current frame was due
+    unsigned long _frameStartUs = 0;
+    Stats _stats;
+
+public:
+    FrameScheduler(uint32_t periodMs, int maxStepsPerFrame = 4)
+        : _period(pdMS_TO_TICKS(periodMs)), _periodUs(periodMs * 1000), _maxStepsPerFrame(max(1, maxStepsPerFrame)) {}
+
+    void start() { _wakeTime = xTaskGetTickCount(); }
+
+    // takes effect from the next frame
+    void setPeriod(uint32_t periodMs)
+    {
+        _period = max((TickType_t)1, pdMS_TO_TICKS(periodMs));
+        _periodUs = periodMs * 1000;
+    }
+
+    // simulation steps to run this frame, at least one
+    int beginFrame();
+    // records the frame's work time and sleeps until the next frame is due, or idleSteps periods later
+    void endFrame(int idleSteps = 0);
+
+    uint32_t periodUs() const { return _periodUs; }
+    const Stats &getStats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+};
+
+int FrameScheduler::beginFrame()
+{
+    _frameStartUs = micros();
+
+    // every whole period since this frame was due is a step that should already have run
+    int32_t late = (int32_t)(xTaskGetTickCount() - _wakeTime);
+    int missed = late > 0 ? late / _period : 0;
+    int steps = 1 + min(missed, _maxStepsPerFrame - 1);
+    _wakeTime += missed * _period;
+
+    _stats.frames++;
+    _stats.steps += steps;
+    _stats.droppedSteps += missed - (steps - 1);
+    return steps;
+}
+
+void FrameScheduler::endFrame(int idleSteps)
+{
+    uint32_t workUs = micros() - _frameStartUs;
+    _stats.totalWorkUs += workUs;
+    _stats.maxWorkUs = max(_stats.maxWorkUs, workUs);
+    if (workUs > _periodUs)
+    {
+        _stats.overruns++;
+    }
+
+    _stats.idleSteps += idleSteps;
+    vTaskDelayUntil(&_wakeTime, _period * (1 + idleSteps));
+}
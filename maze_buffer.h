@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <array>
+#include <utility>
+
+// size of a buffer only known at runtime
+static const int DynamicSize = 0;
+
+// Fixed size buffer: std::array storage when the size is known at compile time, so a fixed size
+// maze needs no heap at all. allocate() only checks the size.
+template <typename T, int Size>
+class MazeBuffer
+{
+private:
+  std::array<T, Size> _data{};
+
+public:
+  void allocate(int) {}
+
+  T *data() { return _data.data(); }
+  const T *data() const { return _data.data(); }
+  int size() const { return Size; }
+  T &operator[](int i) { return _data[i]; }
+  const T &operator[](int i) const { return _data[i]; }
+
+  void swap(MazeBuffer &other) { _data.swap(other._data); }
+};
+
+// Runtime sized buffer: one zero-initialized heap block, allocated once at construction.
+template <typename T>
+class MazeBuffer<T, DynamicSize>
+{
+private:
+  T *_data = nullptr;
+  int _size = 0;
+
+public:
+  MazeBuffer() = default;
+  MazeBuffer(const MazeBuffer &) = delete;
+  MazeBuffer &operator=(const MazeBuffer &) = delete;
+  ~MazeBuffer() { delete[] _data; }
+
+  void allocate(int size)
+  {
+    delete[] _data;
+    // unsigned, so GCC can't see a negative size wrapping past the largest object and warn
+    _data = new T[(unsigned)size]();
+    _size = size;
+  }
+
+  T *data() { return _data; }
+  const T *data() const { return _data; }
+  int size() const { return _size; }
+  T &operator[](int i) { return _data[i]; }
+  const T &operator[](int i) const { return _data[i]; }
+
+  // exchanges the heap blocks without copying
+  void swap(MazeBuffer &other)
+  {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+  }
+};
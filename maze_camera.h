@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_types.h"
+
+// Window of viewWidth x viewHeight cells onto a larger maze, by its top left cell. follow() only moves
+// it as far as it takes to keep the target margin cells inside every edge, and never past the maze
+// edge, so the view holds still while the target wanders around its middle. By default the view is
+// the whole maze and never moves.
+class MazeCamera
+{
+private:
+  int _mazeWidth;
+  int _mazeHeight;
+  int _viewWidth;
+  int _viewHeight;
+  int _margin = 0;
+  int _x = 0;
+  int _y = 0;
+
+public:
+  MazeCamera(int mazeWidth, int mazeHeight)
+      : _mazeWidth(mazeWidth), _mazeHeight(mazeHeight), _viewWidth(mazeWidth), _viewHeight(mazeHeight) {}
+
+  // the view is clipped to the maze and the margin to less than half the view
+  void setView(int viewWidth, int viewHeight, int margin);
+
+  int x() const { return _x; }
+  int y() const { return _y; }
+  int viewWidth() const { return _viewWidth; }
+  int viewHeight() const { return _viewHeight; }
+  bool contains(Location loc) const { return loc.x >= _x && loc.x < _x + _viewWidth && loc.y >= _y && loc.y < _y + _viewHeight; }
+
+  // returns true if the view moved
+  bool follow(Location target);
+  void center(Location target);
+
+private:
+  static int followAxis(int origin, int target, int view, int maze, int margin);
+  static int clampAxis(int origin, int view, int maze) { return max(0, min(origin, maze - view)); }
+};
+
+void MazeCamera::setView(int viewWidth, int viewHeight, int margin)
+{
+  _viewWidth = max(1, min(viewWidth, _mazeWidth));
+  _viewHeight = max(1, min(viewHeight, _mazeHeight));
+  _margin = max(0, min(margin, (min(_viewWidth, _viewHeight) - 1) / 2));
+  _x = clampAxis(_x, _viewWidth, _mazeWidth);
+  _y = clampAxis(_y, _viewHeight, _mazeHeight);
+}
+
+bool MazeCamera::follow(Location target)
+{
+  int x = followAxis(_x, target.x, _viewWidth, _mazeWidth, _margin);
+  int y = followAxis(_y, target.y, _viewHeight, _mazeHeight, _margin);
+  bool moved = x != _x || y != _y;
+  _x = x;
+  _y = y;
+  return moved;
+}
+
+void MazeCamera::center(Location target)
+{
+  _x = clampAxis(target.x - _viewWidth / 2, _viewWidth, _mazeWidth);
+  _y = clampAxis(target.y - _viewHeight / 2, _viewHeight, _mazeHeight);
+}
+
+int MazeCamera::followAxis(int origin, int target, int view, int maze, int margin)
+{
+  if (target < origin + margin)
+  {
+    origin = target - margin;
+  }
+  else if (target > origin + view - 1 - margin)
+  {
+    origin = target - (view - 1 - margin);
+  }
+  return clampAxis(origin, view, maze);
+}
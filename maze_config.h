@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_generators.h"
+
+// runner and sentry behavior, can be changed between games without reflashing
+struct MazeRunnerConfig
+{
+  uint8_t runnerFear = 10; // extra sense when fleeing
+  uint8_t runnerSense = 2;
+  uint8_t runnerSpeed = 3; // ticks between runner moves
+  uint8_t sentrySense = 2;
+  uint8_t sentrySpeed = 5; // ticks between sentry moves
+  bool sentryFlowField = false; // sentries chase along one shared field per runner instead of searching
+  MazeGenerator mazeGenerator = MazeGenerator::CarvedDfs;
+};
+
+enum class GameOutcome : uint8_t
+{
+  None,
+  ReachedExit,
+  Caught,
+  Error
+};
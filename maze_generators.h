@@ -0,0 +1,493 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_random.h"
+#include "maze_types.h"
+
+// Maze generators carve a perfect maze (exactly one path between any two open cells) into a grid that
+// starts out all walls, always opening start. Each one is a class with a static generate() taking the
+// walls, the start cell, the random source and scratch room for width * height ints, so adding an
+// algorithm takes a class here and a case in MazeRunnerEngine::generateMaze(). None of them allocate.
+enum class MazeGenerator : uint8_t
+{
+  CarvedDfs,   // randomized DFS through the grid cells themselves, corridors wander freely
+  GrowingTree, // lattice, mostly newest cell first with some random picks, long corridors with side branches
+  Wilson,      // lattice, loop-erased random walks, every spanning tree equally likely
+  Eller,       // lattice, one row at a time, see EllerRowStream
+  Chunked,     // lattice, independent 32x32 chunks joined in a tree, see ChunkedGenerator
+  Count
+};
+
+// Randomized DFS that opens a wall cell only if it stays enclosed by at least three walls, so
+// corridors stay one cell wide. Each cell is pushed at most once, so the stack needs width * height.
+class CarvedDfsGenerator
+{
+public:
+  template <typename Grid>
+  static void generate(Grid &walls, Location start, MazeRandom &random, int *scratch);
+};
+
+// Lattice generators place cells on every other row and column, aligned so start is one of them,
+// and join two neighboring cells by opening the grid cell between them.
+class MazeLattice
+{
+public:
+  int originX;
+  int originY;
+  int width;
+  int height;
+
+  template <typename Grid>
+  MazeLattice(const Grid &walls, Location start)
+      : originX(start.x % 2), originY(start.y % 2),
+        width((walls.width() - start.x % 2 + 1) / 2), height((walls.height() - start.y % 2 + 1) / 2) {}
+
+  int cellCount() const { return width * height; }
+  int toCell(Location loc) const { return (loc.y - originY) / 2 * width + (loc.x - originX) / 2; }
+  Location toGrid(int cell) const { return {originX + 2 * (cell % width), originY + 2 * (cell / width)}; }
+
+  // neighboring cell in Directions order, -1 past the lattice edge
+  int neighbor(int cell, int direction) const;
+  static int directionIndex(Direction step) { return step.x != 0 ? (step.x < 0 ? 0 : 1) : (step.y < 0 ? 2 : 3); }
+
+  template <typename Grid>
+  bool isOpen(const Grid &walls, int cell) const
+  {
+    Location loc = toGrid(cell);
+    return !walls.get(loc.x, loc.y);
+  }
+
+  template <typename Grid>
+  void open(Grid &walls, int cell) const
+  {
+    Location loc = toGrid(cell);
+    walls.set(loc.x, loc.y, false);
+  }
+
+  // opens the grid cell between cell and its neighbor in direction
+  template <typename Grid>
+  void join(Grid &walls, int cell, int direction) const
+  {
+    Location loc = toGrid(cell);
+    walls.set(loc.x + Directions[direction].x, loc.y + Directions[direction].y, false);
+  }
+};
+
+// Growing tree: grows from a list of active cells, taking the newest most of the time (DFS-like)
+// and a random one otherwise (Prim-like). The active list needs one int per lattice cell.
+class GrowingTreeGenerator
+{
+public:
+  template <typename Grid>
+  static void generate(Grid &walls, Location start, MazeRandom &random, int *scratch);
+};
+
+// Wilson's algorithm: random walks from each cell outside the maze until they hit it, then carves
+// the walk with its loops erased. Uses one int per lattice cell for the walk directions.
+class WilsonGenerator
+{
+public:
+  template <typename Grid>
+  static void generate(Grid &walls, Location start, MazeRandom &random, int *scratch);
+};
+
+// Eller's algorithm: builds the maze one lattice row at a time keeping only the current row's sets,
+// so memory is O(width) and rows can be streamed with no height limit, e.g. for an endless
+// scrolling maze. Sets are relabeled to column numbers every row, so all state fits in stateSize() ints.
+class EllerRowStream
+{
+private:
+  int _gridWidth;
+  int _originX;
+  int _cells; // lattice cells per row
+  int *_sets;    // set label of each cell in the current row
+  int *_parents; // union-find over labels while joining a row
+  int *_counts;  // cells per label, for picking one to link down
+  int *_picks;
+  int *_flags;
+
+public:
+  static int stateSize(int gridWidth) { return 5 * ((gridWidth + 1) / 2); }
+
+  EllerRowStream(int gridWidth, int originX, int *state);
+
+  // writes the next lattice row as two grid rows of wall bits: cellRow with the cells and the joins
+  // between them, then linkRow with the joins down to the following row. The last row joins every
+  // remaining set and has no links, so the maze ends connected. linkRow may be null on the last row.
+  void nextRows(MazeRandom &random, uint32_t *cellRow, uint32_t *linkRow, bool lastRow);
+
+  template <typename Grid>
+  static void generate(Grid &walls, Location start, MazeRandom &random, int *scratch);
+
+private:
+  int find(int label);
+  void fillWalls(uint32_t *row);
+  static void clearBit(uint32_t *row, int x) { row[x / 32] &= ~(1u << (x % 32)); }
+  static bool getBit(const uint32_t *row, int x) { return (row[x / 32] >> (x % 32)) & 1; }
+};
+
+// Chunked: the grid is cut into ChunkSize square chunks of the lattice, each a growing tree maze of its
+// own seeded from one maze seed and its chunk coordinates, joined through its east or south border to
+// one neighbor so the chunks form a tree. Any chunk can be built alone in O(ChunkSize^2) without the
+// others. Chunks only meet at one gap each, so paths between distant cells wander more than in the
+// other generators.
+class ChunkedGenerator
+{
+public:
+  static const int ChunkSize = 32; // one word per chunk row
+  static const int ScratchSize = (ChunkSize / 2) * (ChunkSize / 2);
+
+  static int chunksAcross(int size, int origin) { return (size - origin + ChunkSize - 1) / ChunkSize; }
+
+  // Walls of chunk (chunkX, chunkY) of a width x height maze whose lattice starts at (originX, originY),
+  // one word per chunk row with bit 0 the chunk's first column. Bits past the maze edge are set.
+  // Needs ScratchSize ints of scratch, or one per lattice cell of the maze if that's fewer.
+  static void generateChunk(uint64_t seed, int width, int height, int originX, int originY, int chunkX, int chunkY,
+                            uint32_t *rows, int *scratch);
+
+  // every chunk, seeded by two draws from random
+  template <typename Grid>
+  static void generate(Grid &walls, Location start, MazeRandom &random, int *scratch);
+
+private:
+  // the inside of one chunk, clipped to the maze, as a grid for the lattice generators
+  struct ChunkCanvas
+  {
+    uint32_t *rows;
+    int canvasWidth;
+    int canvasHeight;
+
+    int width() const { return canvasWidth; }
+    int height() const { return canvasHeight; }
+    bool get(int x, int y) const { return (rows[y] >> x) & 1; }
+    void set(int x, int y, bool value) { rows[y] = value ? rows[y] | (1u << x) : rows[y] & ~(1u << x); }
+  };
+};
+
+template <typename Grid>
+void CarvedDfsGenerator::generate(Grid &walls, Location start, MazeRandom &random, int *scratch)
+{
+  int width = walls.width();
+  int height = walls.height();
+  walls.set(start.x, start.y, false);
+
+  int stackSize = 0;
+  scratch[stackSize++] = start.y * width + start.x;
+  while (stackSize > 0)
+  {
+    Location cur = {scratch[stackSize - 1] % width, scratch[stackSize - 1] / width};
+    const DirectionOrder &randSteps = DirectionOrders[random.uniform(24)];
+
+    // try to move in each direction, pop location if no path forward
+    bool foundPath = false;
+    for (int i = 0; i < 4; i++)
+    {
+      Location nextLoc = {cur.x + randSteps[i].x, cur.y + randSteps[i].y};
+      bool inBounds = nextLoc.x >= 0 && nextLoc.x < width && nextLoc.y >= 0 && nextLoc.y < height;
+      if (inBounds && walls.get(nextLoc.x, nextLoc.y) && walls.getAdjacentSetOrBorderCount(nextLoc.x, nextLoc.y) >= 3)
+      {
+        walls.set(nextLoc.x, nextLoc.y, false);
+        scratch[stackSize++] = nextLoc.y * width + nextLoc.x;
+        foundPath = true;
+        break;
+      }
+    }
+
+    if (!foundPath)
+    {
+      stackSize--;
+    }
+  }
+}
+
+inline int MazeLattice::neighbor(int cell, int direction) const
+{
+  int x = cell % width + Directions[direction].x;
+  int y = cell / width + Directions[direction].y;
+  return x >= 0 && x < width && y >= 0 && y < height ? y * width + x : -1;
+}
+
+template <typename Grid>
+void GrowingTreeGenerator::generate(Grid &walls, Location start, MazeRandom &random, int *scratch)
+{
+  MazeLattice lattice(walls, start);
+  int startCell = lattice.toCell(start);
+  lattice.open(walls, startCell);
+
+  int activeCount = 0;
+  scratch[activeCount++] = startCell;
+  while (activeCount > 0)
+  {
+    int pick = random.uniform(4) == 0 ? random.uniform(activeCount) : activeCount - 1;
+    int cell = scratch[pick];
+
+    const DirectionOrder &randSteps = DirectionOrders[random.uniform(24)];
+    bool grew = false;
+    for (int i = 0; i < 4; i++)
+    {
+      int direction = MazeLattice::directionIndex(randSteps[i]);
+      int next = lattice.neighbor(cell, direction);
+      if (next >= 0 && !lattice.isOpen(walls, next))
+      {
+        lattice.join(walls, cell, direction);
+        lattice.open(walls, next);
+        scratch[activeCount++] = next;
+        grew = true;
+        break;
+      }
+    }
+
+    // no closed neighbors left, retire the cell
+    if (!grew)
+    {
+      scratch[pick] = scratch[--activeCount];
+    }
+  }
+}
+
+template <typename Grid>
+void WilsonGenerator::generate(Grid &walls, Location start, MazeRandom &random, int *scratch)
+{
+  MazeLattice lattice(walls, start);
+  lattice.open(walls, lattice.toCell(start));
+
+  for (int first = 0; first < lattice.cellCount(); first++)
+  {
+    if (lattice.isOpen(walls, first))
+    {
+      continue;
+    }
+
+    // walk until the maze is hit, a revisited cell's direction is overwritten, which erases the loop
+    int cell = first;
+    while (!lattice.isOpen(walls, cell))
+    {
+      int direction, next;
+      do
+      {
+        direction = random.uniform(4);
+        next = lattice.neighbor(cell, direction);
+      } while (next < 0);
+      scratch[cell] = direction;
+      cell = next;
+    }
+
+    // carve the walk as it was last left
+    cell = first;
+    while (!lattice.isOpen(walls, cell))
+    {
+      lattice.open(walls, cell);
+      lattice.join(walls, cell, scratch[cell]);
+      cell = lattice.neighbor(cell, scratch[cell]);
+    }
+  }
+}
+
+inline EllerRowStream::EllerRowStream(int gridWidth, int originX, int *state)
+{
+  _gridWidth = gridWidth;
+  _originX = originX;
+  _cells = (gridWidth - originX + 1) / 2;
+  int stride = (gridWidth + 1) / 2;
+  _sets = state;
+  _parents = state + stride;
+  _counts = state + 2 * stride;
+  _picks = state + 3 * stride;
+  _flags = state + 4 * stride;
+
+  // every cell of the first row starts in a set of its own
+  for (int c = 0; c < _cells; c++)
+  {
+    _sets[c] = c;
+  }
+}
+
+inline void EllerRowStream::nextRows(MazeRandom &random, uint32_t *cellRow, uint32_t *linkRow, bool lastRow)
+{
+  fillWalls(cellRow);
+  if (linkRow != nullptr)
+  {
+    fillWalls(linkRow);
+  }
+
+  for (int c = 0; c < _cells; c++)
+  {
+    clearBit(cellRow, _originX + 2 * c);
+    _parents[c] = c;
+  }
+
+  // join neighbors from different sets at random, or always on the last row
+  for (int c = 0; c + 1 < _cells; c++)
+  {
+    int left = find(_sets[c]);
+    int right = find(_sets[c + 1]);
+    if (left != right && (lastRow || random.uniform(2) == 0))
+    {
+      _parents[right] = left;
+      clearBit(cellRow, _originX + 2 * c + 1);
+    }
+  }
+  for (int c = 0; c < _cells; c++)
+  {
+    _sets[c] = find(_sets[c]);
+  }
+
+  if (lastRow)
+  {
+    return;
+  }
+
+  // link cells down at random, then one random cell of every set that got no link
+  for (int label = 0; label < _cells; label++)
+  {
+    _counts[label] = 0;
+    _flags[label] = 0;
+  }
+  for (int c = 0; c < _cells; c++)
+  {
+    int set = _sets[c];
+    if (random.uniform(++_counts[set]) == 0)
+    {
+      _picks[set] = c;
+    }
+    if (random.uniform(2) == 0)
+    {
+      clearBit(linkRow, _originX + 2 * c);
+      _flags[set] = 1;
+    }
+  }
+  for (int c = 0; c < _cells; c++)
+  {
+    int set = _sets[c];
+    if (_flags[set] == 0 && _picks[set] == c)
+    {
+      clearBit(linkRow, _originX + 2 * c);
+      _flags[set] = 1;
+    }
+  }
+
+  // the next row: linked cells keep their set, the others take labels no linked cell uses
+  for (int label = 0; label < _cells; label++)
+  {
+    _flags[label] = 0;
+  }
+  for (int c = 0; c < _cells; c++)
+  {
+    if (!getBit(linkRow, _originX + 2 * c))
+    {
+      _flags[_sets[c]] = 1;
+    }
+  }
+  int freeLabel = 0;
+  for (int c = 0; c < _cells; c++)
+  {
+    if (getBit(linkRow, _originX + 2 * c))
+    {
+      while (_flags[freeLabel] != 0)
+      {
+        freeLabel++;
+      }
+      _sets[c] = freeLabel;
+      _flags[freeLabel] = 1;
+    }
+  }
+}
+
+template <typename Grid>
+void EllerRowStream::generate(Grid &walls, Location start, MazeRandom &random, int *scratch)
+{
+  MazeLattice lattice(walls, start);
+  EllerRowStream stream(walls.width(), lattice.originX, scratch);
+  for (int row = 0; row < lattice.height; row++)
+  {
+    int y = lattice.originY + 2 * row;
+    stream.nextRows(random, walls.row(y), y + 1 < walls.height() ? walls.row(y + 1) : nullptr, row == lattice.height - 1);
+  }
+}
+
+inline int EllerRowStream::find(int label)
+{
+  while (_parents[label] != label)
+  {
+    _parents[label] = _parents[_parents[label]];
+    label = _parents[label];
+  }
+  return label;
+}
+
+inline void EllerRowStream::fillWalls(uint32_t *row)
+{
+  int words = (_gridWidth + 31) / 32;
+  for (int w = 0; w < words; w++)
+  {
+    int bits = _gridWidth - w * 32;
+    row[w] = bits >= 32 ? 0xFFFFFFFF : (1u << bits) - 1;
+  }
+}
+
+inline void ChunkedGenerator::generateChunk(uint64_t seed, int width, int height, int originX, int originY, int chunkX, int chunkY,
+                                            uint32_t *rows, int *scratch)
+{
+  int chunksX = chunksAcross(width, originX);
+  int chunksY = chunksAcross(height, originY);
+  int innerWidth = min(ChunkSize - 1, width - originX - chunkX * ChunkSize);
+  int innerHeight = min(ChunkSize - 1, height - originY - chunkY * ChunkSize);
+  for (int y = 0; y < ChunkSize; y++)
+  {
+    rows[y] = 0xFFFFFFFF;
+  }
+
+  MazeRandom random(seed ^ ((uint64_t)chunkY << 32 | (uint32_t)chunkX));
+  ChunkCanvas canvas = {rows, innerWidth, innerHeight};
+  GrowingTreeGenerator::generate(canvas, {0, 0}, random, scratch);
+
+  // each chunk but the last links to the next one east or south, the last column always south and
+  // the last row always east, which joins every chunk into one tree
+  bool lastColumn = chunkX == chunksX - 1;
+  bool lastRow = chunkY == chunksY - 1;
+  if (lastColumn && lastRow)
+  {
+    return;
+  }
+  if (lastRow || (!lastColumn && random.uniform(2) == 0))
+  {
+    rows[2 * random.uniform((innerHeight + 1) / 2)] &= ~(1u << (ChunkSize - 1));
+  }
+  else
+  {
+    rows[ChunkSize - 1] &= ~(1u << (2 * random.uniform((innerWidth + 1) / 2)));
+  }
+}
+
+template <typename Grid>
+void ChunkedGenerator::generate(Grid &walls, Location start, MazeRandom &random, int *scratch)
+{
+  uint64_t seed = random.next();
+  seed = seed << 32 | random.next();
+  int originX = start.x % 2;
+  int originY = start.y % 2;
+
+  uint32_t rows[ChunkSize];
+  for (int chunkY = 0; chunkY < chunksAcross(walls.height(), originY); chunkY++)
+  {
+    for (int chunkX = 0; chunkX < chunksAcross(walls.width(), originX); chunkX++)
+    {
+      generateChunk(seed, walls.width(), walls.height(), originX, originY, chunkX, chunkY, rows, scratch);
+
+      int left = originX + chunkX * ChunkSize;
+      int top = originY + chunkY * ChunkSize;
+      for (int y = 0; y < ChunkSize && top + y < walls.height(); y++)
+      {
+        for (uint32_t open = ~rows[y]; open != 0; open &= open - 1)
+        {
+          int x = left + __builtin_ctz(open);
+          if (x < walls.width())
+          {
+            walls.set(x, top + y, false);
+          }
+        }
+      }
+    }
+  }
+}
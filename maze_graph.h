@@ -0,0 +1,731 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_buffer.h"
+#include "maze_random.h"
+#include "maze_types.h"
+
+// Corridor graph of a maze: nodes at junctions and dead ends, and edges along the one cell wide
+// corridors between them, with their length and cells. Generated mazes are mostly corridor, so a
+// search over the graph expands a small fraction of the cells a cell by cell search does, and only
+// walks cells for the path it returns. A search that starts or ends inside a corridor splits it there
+// into a node for the search and merges it back after.
+//
+// A maze with few loops is a tree almost everywhere: peeling dead ends off until only loops are left
+// hangs most nodes in pockets, trees that connect to the rest through the node they hang from. A
+// path never passes through a pocket, so path searches only enter the pockets around their end, and
+// the farthest cell search reads each pocket's deepest dead end instead of expanding it. Directions
+// index Left, Right, Up, Down, the order of Directions. Size is either fixed at compile time or
+// DynamicSize.
+template <int CellCount = DynamicSize>
+class MazeGraph
+{
+private:
+  static constexpr int ArcCapacity = CellCount == DynamicSize ? DynamicSize : 4 * CellCount;
+  static const int NoSlot = INT32_MIN;
+  static const int UnassignedCorridor = INT32_MIN + 1; // plus open neighbors, ~edge of every real edge is above this
+  static const int MaxSplits = 2;                      // a search's start and end
+  static const int NoLink = 15;                        // no node to hang from in the core, no child in a leaf
+
+  struct Edge
+  {
+    int nodes[2];    // the cells run from nodes[0] to nodes[1]
+    uint8_t dirs[2]; // direction the edge leaves each of its nodes in
+    int firstCell;   // into _edgeCells
+    int length;      // steps from end to end, one more than its cells
+  };
+
+  int _width = 0;
+  int _height = 0;
+  int _capacity = 0;
+  int _nodeCount = 0;
+  int _edgeCount = 0;
+  int _cellsUsed = 0;
+  bool _valid = false;
+  MazeBuffer<int, CellCount> _cellSlots;   // node id for nodes, ~edge for corridor cells, NoSlot for walls
+  MazeBuffer<int, CellCount> _nodeCells;
+  MazeBuffer<int, ArcCapacity> _nodeEdges; // edge leaving each node in each direction, -1 if none
+  MazeBuffer<Edge, CellCount> _edges;
+  MazeBuffer<int, CellCount> _edgeCells;   // every corridor cell once, grouped by edge
+  MazeBuffer<uint8_t, CellCount> _pocketLinks; // direction to the node each hangs from, and to its deepest child << 4
+  MazeBuffer<int, CellCount> _pocketDepths;    // steps down to the deepest dead end of each node's pocket
+  MazeBuffer<uint16_t, CellCount> _visitedStamps;
+  MazeBuffer<uint16_t, CellCount> _markStamps; // the end's ancestors in findPath(), settled nodes in findFarthestCell()
+  uint16_t _searchStamp = 0;
+  int _lastSearchNodes = 0;
+
+public:
+  void allocate(int cellCount);
+
+  // Walls only change when a maze is built, so the graph is built once with it, in O(cells). Returns
+  // false, and leaves the graph invalid, if the maze has more corridors than cells to hold them, as
+  // only a mostly open grid can. Such a maze has to be searched cell by cell.
+  template <typename Grid>
+  bool build(const Grid &walls);
+  bool isValid() const { return _valid; }
+  void clear() { _valid = false; }
+  // exchanges contents with a graph of the same capacity, O(1) for runtime sized graphs
+  void swap(MazeGraph &other);
+
+  int nodeCount() const { return _nodeCount; }
+  int edgeCount() const { return _edgeCount; }
+  // graph nodes the last search expanded
+  int lastSearchNodes() const { return _lastSearchNodes; }
+
+  // A random depth first path from startCell to endCell, like MazeRunnerEngine::findPathDfs(), that
+  // never enters blockedCells. The path is written without the start cell. stack and depths need
+  // room for 4 entries per cell, pathArcs for one per cell.
+  template <typename Path>
+  bool findPath(int startCell, int endCell, const int *blockedCells, int blockedCount, MazeRandom &random,
+                int *stack, int *depths, int *pathArcs, Path *path);
+
+  // Cell farthest from startCell along the shortest path, -1 if no other cell is reachable. Node
+  // distances come from Dijkstra over the edge lengths outside the pockets, the farthest cell inside
+  // each corridor between them follows from the distances to its two ends, and each pocket adds its
+  // deepest dead end. heapNodes and heapDists need room for 4 entries per cell, dists for one per cell.
+  int findFarthestCell(int startCell, int *heapNodes, int *heapDists, int *dists, int *farthestDist);
+
+private:
+  bool isNode(int cell) const { return _cellSlots[cell] >= 0; }
+  int direction(int fromCell, int toCell) const;
+  int otherEnd(int node, int dir) const;
+  int arrivalDir(int node, int dir) const;
+  int pocketParent(int node) const { return _pocketLinks[node] & 15; }
+  int pocketDeepest(int node) const { return _pocketLinks[node] >> 4; }
+  // the node at the other end of the arc hangs from node through it
+  bool hangsFrom(int node, int dir) const { return pocketParent(otherEnd(node, dir)) == arrivalDir(node, dir); }
+  void findPockets();
+  bool isUnassignedCorridor(int cell) const { return _cellSlots[cell] > NoSlot && _cellSlots[cell] <= UnassignedCorridor + 15; }
+  bool trace(int node, int dir);
+  void splitAt(int cell);
+  void mergeLastSplit();
+  bool isBlocked(int edge, int node, const int *blockedCells, int blockedCount) const;
+  template <typename Path>
+  void appendArc(int node, int dir, Path *path) const;
+  void beginSearch();
+  bool isVisited(int node) const { return _visitedStamps[node] == _searchStamp; }
+  void markVisited(int node) { _visitedStamps[node] = _searchStamp; }
+  bool isMarked(int node) const { return _markStamps[node] == _searchStamp; }
+  void mark(int node) { _markStamps[node] = _searchStamp; }
+
+  static void heapPush(int *nodes, int *dists, int &size, int node, int dist);
+  static void heapPop(int *nodes, int *dists, int &size, int &node, int &dist);
+};
+
+template <int CellCount>
+void MazeGraph<CellCount>::allocate(int cellCount)
+{
+  _cellSlots.allocate(cellCount);
+  _nodeEdges.allocate(4 * cellCount);
+  _nodeCells.allocate(cellCount);
+  _edges.allocate(cellCount);
+  _edgeCells.allocate(cellCount);
+  _pocketLinks.allocate(cellCount);
+  _pocketDepths.allocate(cellCount);
+  _visitedStamps.allocate(cellCount);
+  _markStamps.allocate(cellCount);
+  _capacity = cellCount;
+}
+
+template <int CellCount>
+template <typename Grid>
+bool MazeGraph<CellCount>::build(const Grid &walls)
+{
+  _valid = false;
+  _width = walls.width();
+  _height = walls.height();
+  if (_width * _height > _capacity)
+  {
+    return false;
+  }
+
+  // corridor cells have exactly two open neighbors, anything else open is a node
+  _nodeCount = 0;
+  _edgeCount = 0;
+  _cellsUsed = 0;
+  for (int cell = 0; cell < _width * _height; cell++)
+  {
+    _cellSlots[cell] = NoSlot;
+  }
+  int words = walls.wordsPerRow();
+  for (int y = 0; y < _height; y++)
+  {
+    const uint32_t *row = walls.row(y);
+    const uint32_t *above = y > 0 ? walls.row(y - 1) : nullptr;
+    const uint32_t *below = y + 1 < _height ? walls.row(y + 1) : nullptr;
+    for (int w = 0; w < words; w++)
+    {
+      // the wall to each cell's left, right, top and bottom, a word at a time, the border counts as wall
+      uint32_t valid = walls.wordMask(w);
+      uint32_t left = (row[w] << 1) | (w > 0 ? row[w - 1] >> 31 : 1);
+      uint32_t right = (row[w] >> 1) | (w + 1 < words ? row[w + 1] << 31 : 1u << 31) | (~valid >> 1);
+      uint32_t up = above != nullptr ? above[w] : 0xFFFFFFFF;
+      uint32_t down = below != nullptr ? below[w] : 0xFFFFFFFF;
+      for (uint32_t open = ~row[w] & valid; open != 0; open &= open - 1)
+      {
+        int bit = __builtin_ctz(open);
+        int cell = y * _width + w * 32 + bit;
+        // open neighbors as a mask over Directions, kept on corridor cells for trace() to follow
+        int openDirs = ~(((left >> bit) & 1) | (((right >> bit) & 1) << 1) | (((up >> bit) & 1) << 2) | (((down >> bit) & 1) << 3)) & 15;
+        if (__builtin_popcount(openDirs) != 2)
+        {
+          _cellSlots[cell] = _nodeCount;
+          _nodeCells[_nodeCount++] = cell;
+        }
+        else
+        {
+          _cellSlots[cell] = UnassignedCorridor + openDirs;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < 4 * _nodeCount; i++)
+  {
+    _nodeEdges[i] = -1;
+  }
+
+  for (int node = 0; node < _nodeCount; node++)
+  {
+    for (int dir = 0; dir < 4; dir++)
+    {
+      if (_nodeEdges[node * 4 + dir] < 0 && !trace(node, dir))
+      {
+        return false;
+      }
+    }
+  }
+
+  // a loop of corridor with no junction on it can only be off on its own, it gets a node to hang from
+  for (int cell = 0; cell < _width * _height; cell++)
+  {
+    if (!isUnassignedCorridor(cell))
+    {
+      continue;
+    }
+    int node = _nodeCount++;
+    _cellSlots[cell] = node;
+    _nodeCells[node] = cell;
+    for (int dir = 0; dir < 4; dir++)
+    {
+      _nodeEdges[node * 4 + dir] = -1;
+    }
+    for (int dir = 0; dir < 4; dir++)
+    {
+      if (_nodeEdges[node * 4 + dir] < 0 && !trace(node, dir))
+      {
+        return false;
+      }
+    }
+  }
+
+  findPockets();
+  _valid = true;
+  return true;
+}
+
+// Peels off every node left with one arc to a node still in the graph, which it then hangs from, and
+// its depth goes to that parent. Each peeled parent has all its children peeled already, so depths
+// are final by then. What stays is the core every loop runs through, plus one node of each part of
+// the maze without loops.
+template <int CellCount>
+void MazeGraph<CellCount>::findPockets()
+{
+  // arcs to nodes still in the graph, kept in the visit stamps until searches need them
+  for (int node = 0; node < _nodeCount; node++)
+  {
+    int arcs = 0;
+    for (int dir = 0; dir < 4; dir++)
+    {
+      arcs += _nodeEdges[node * 4 + dir] >= 0 ? 1 : 0;
+    }
+    _visitedStamps[node] = arcs;
+    _pocketLinks[node] = NoLink | (NoLink << 4);
+    _pocketDepths[node] = 0;
+  }
+
+  for (int leaf = 0; leaf < _nodeCount; leaf++)
+  {
+    int node = leaf;
+    while (_visitedStamps[node] == 1 && pocketParent(node) == NoLink)
+    {
+      int dir = 0;
+      while (_nodeEdges[node * 4 + dir] < 0 || pocketParent(otherEnd(node, dir)) != NoLink)
+      {
+        dir++;
+      }
+      int parent = otherEnd(node, dir);
+      int parentDir = arrivalDir(node, dir);
+      int depth = _edges[_nodeEdges[node * 4 + dir]].length + _pocketDepths[node];
+      _pocketLinks[node] = (_pocketLinks[node] & 0xF0) | dir;
+      _visitedStamps[node] = 0;
+      _visitedStamps[parent]--;
+      if (pocketDeepest(parent) == NoLink || depth > _pocketDepths[parent])
+      {
+        _pocketLinks[parent] = (_pocketLinks[parent] & 15) | (parentDir << 4);
+        _pocketDepths[parent] = depth;
+      }
+      node = parent;
+    }
+  }
+
+  // the stamp restarts, so clear the split nodes' stale marks past the nodes too
+  memset(_visitedStamps.data(), 0, _capacity * sizeof(uint16_t));
+  memset(_markStamps.data(), 0, _capacity * sizeof(uint16_t));
+  _searchStamp = 0;
+}
+
+// walks the corridor leaving node in dir to the node at its other end, if there is one, and adds it
+template <int CellCount>
+bool MazeGraph<CellCount>::trace(int node, int dir)
+{
+  int x = _nodeCells[node] % _width + Directions[dir].x;
+  int y = _nodeCells[node] / _width + Directions[dir].y;
+  if (x < 0 || x >= _width || y < 0 || y >= _height || _cellSlots[y * _width + x] == NoSlot)
+  {
+    return true;
+  }
+  // leave room for a search to split its start and end out of their corridors
+  if (_edgeCount + MaxSplits >= _capacity)
+  {
+    return false;
+  }
+
+  int edgeIndex = _edgeCount++;
+  Edge &edge = _edges[edgeIndex];
+  edge.nodes[0] = node;
+  edge.dirs[0] = dir;
+  edge.firstCell = _cellsUsed;
+  edge.length = 1;
+  // each corridor cell leaves by its other open neighbor, Directions pair up as opposites so the
+  // way back is always d ^ 1
+  const int steps[4] = {-1, 1, -_width, _width};
+  int cur = y * _width + x;
+  int back = dir ^ 1;
+  while (!isNode(cur))
+  {
+    int open = _cellSlots[cur] - UnassignedCorridor;
+    _cellSlots[cur] = ~edgeIndex;
+    _edgeCells[_cellsUsed++] = cur;
+    int d = __builtin_ctz(open & ~(1 << back));
+    cur += steps[d];
+    back = d ^ 1;
+    edge.length++;
+  }
+
+  edge.nodes[1] = _cellSlots[cur];
+  edge.dirs[1] = back;
+  _nodeEdges[node * 4 + dir] = edgeIndex;
+  _nodeEdges[edge.nodes[1] * 4 + edge.dirs[1]] = edgeIndex;
+  return true;
+}
+
+template <int CellCount>
+void MazeGraph<CellCount>::swap(MazeGraph &other)
+{
+  std::swap(_width, other._width);
+  std::swap(_height, other._height);
+  std::swap(_capacity, other._capacity);
+  std::swap(_nodeCount, other._nodeCount);
+  std::swap(_edgeCount, other._edgeCount);
+  std::swap(_cellsUsed, other._cellsUsed);
+  std::swap(_valid, other._valid);
+  _cellSlots.swap(other._cellSlots);
+  _nodeCells.swap(other._nodeCells);
+  _nodeEdges.swap(other._nodeEdges);
+  _edges.swap(other._edges);
+  _edgeCells.swap(other._edgeCells);
+  _pocketLinks.swap(other._pocketLinks);
+  _pocketDepths.swap(other._pocketDepths);
+}
+
+template <int CellCount>
+template <typename Path>
+bool MazeGraph<CellCount>::findPath(int startCell, int endCell, const int *blockedCells, int blockedCount, MazeRandom &random,
+                                    int *stack, int *depths, int *pathArcs, Path *path)
+{
+  int splits = 0;
+  for (int cell : {startCell, endCell})
+  {
+    if (!isNode(cell))
+    {
+      splitAt(cell);
+      splits++;
+    }
+  }
+  int startNode = _cellSlots[startCell];
+  int endNode = _cellSlots[endCell];
+
+  // entries are arcs, node * 4 + dir, with -1 for the start
+  beginSearch();
+  _lastSearchNodes = 0;
+  // the pockets holding the end are the only ones worth entering
+  for (int node = endNode; ; node = otherEnd(node, pocketParent(node)))
+  {
+    mark(node);
+    if (pocketParent(node) == NoLink)
+    {
+      break;
+    }
+  }
+  bool found = false;
+  int stackSize = 0;
+  stack[stackSize] = -1;
+  depths[stackSize++] = 0;
+  while (stackSize > 0)
+  {
+    stackSize--;
+    int arc = stack[stackSize];
+    int depth = depths[stackSize];
+    int node = arc < 0 ? startNode : otherEnd(arc / 4, arc % 4);
+    if (isVisited(node))
+    {
+      continue;
+    }
+
+    // unwind the path to this depth
+    pathArcs[depth] = arc;
+    if (node == endNode)
+    {
+      if (path != nullptr)
+      {
+        path->clear();
+        for (int i = 1; i <= depth; i++)
+        {
+          appendArc(pathArcs[i] / 4, pathArcs[i] % 4, path);
+        }
+      }
+      found = true;
+      break;
+    }
+
+    markVisited(node);
+    _lastSearchNodes++;
+
+    // look in different directions randomly in case of loops for variety of potential paths
+    const DirectionOrder &randSteps = DirectionOrders[random.uniform(24)];
+    for (Direction step : randSteps)
+    {
+      int dir = step.x != 0 ? (step.x < 0 ? 0 : 1) : (step.y < 0 ? 2 : 3);
+      int edge = _nodeEdges[node * 4 + dir];
+      if (edge < 0)
+      {
+        continue;
+      }
+      int next = otherEnd(node, dir);
+      if (!isVisited(next) && (isMarked(next) || !hangsFrom(node, dir)) && !isBlocked(edge, next, blockedCells, blockedCount))
+      {
+        stack[stackSize] = node * 4 + dir;
+        depths[stackSize++] = depth + 1;
+      }
+    }
+  }
+
+  while (splits-- > 0)
+  {
+    mergeLastSplit();
+  }
+  return found;
+}
+
+template <int CellCount>
+int MazeGraph<CellCount>::findFarthestCell(int startCell, int *heapNodes, int *heapDists, int *dists, int *farthestDist)
+{
+  bool split = !isNode(startCell);
+  if (split)
+  {
+    splitAt(startCell);
+  }
+  int startNode = _cellSlots[startCell];
+
+  // visited marks nodes with a distance, which is final once popped at that distance, and marked
+  // ones are popped. Pockets are never entered, unless the start is in one and the search climbs out.
+  beginSearch();
+  _lastSearchNodes = 0;
+  int farthestCell = startCell;
+  int farthestPocket = -1;
+  *farthestDist = 0;
+  int heapSize = 0;
+  markVisited(startNode);
+  dists[startNode] = 0;
+  heapPush(heapNodes, heapDists, heapSize, startNode, 0);
+  while (heapSize > 0)
+  {
+    int node;
+    int dist;
+    heapPop(heapNodes, heapDists, heapSize, node, dist);
+    if (dist > dists[node])
+    {
+      continue;
+    }
+    mark(node);
+    _lastSearchNodes++;
+    if (dist > *farthestDist)
+    {
+      farthestCell = _nodeCells[node];
+      farthestPocket = -1;
+      *farthestDist = dist;
+    }
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int edgeIndex = _nodeEdges[node * 4 + dir];
+      if (edgeIndex < 0)
+      {
+        continue;
+      }
+      const Edge &edge = _edges[edgeIndex];
+      int next = otherEnd(node, dir);
+      int nextDist = dist + edge.length;
+      if (isMarked(next))
+      {
+        // both ends are settled, inside the corridor the distance is the shorter way round, so it
+        // peaks where both ways meet. A loop on one node is seen from both its ends, once is enough.
+        if (edge.length < 2 || (next == node && edge.dirs[0] != dir))
+        {
+          continue;
+        }
+        int fromDist = dists[edge.nodes[0]];
+        int toDist = dists[edge.nodes[1]];
+        int peak = max(1, min(edge.length - 1, (toDist + edge.length - fromDist) / 2));
+        for (int step = peak; step <= min(peak + 1, edge.length - 1); step++)
+        {
+          int cellDist = min(fromDist + step, toDist + edge.length - step);
+          if (cellDist > *farthestDist)
+          {
+            farthestCell = _edgeCells[edge.firstCell + step - 1];
+            farthestPocket = -1;
+            *farthestDist = cellDist;
+          }
+        }
+      }
+      else if (!isVisited(next) && hangsFrom(node, dir))
+      {
+        // distances only grow down a pocket, its deepest dead end is the farthest cell in it
+        if (nextDist + _pocketDepths[next] > *farthestDist)
+        {
+          farthestPocket = next;
+          *farthestDist = nextDist + _pocketDepths[next];
+        }
+      }
+      else if (!isVisited(next) || nextDist < dists[next])
+      {
+        markVisited(next);
+        dists[next] = nextDist;
+        heapPush(heapNodes, heapDists, heapSize, next, nextDist);
+      }
+    }
+  }
+
+  if (farthestPocket >= 0)
+  {
+    int node = farthestPocket;
+    while (pocketDeepest(node) != NoLink)
+    {
+      node = otherEnd(node, pocketDeepest(node));
+    }
+    farthestCell = _nodeCells[node];
+  }
+
+  if (split)
+  {
+    mergeLastSplit();
+  }
+  return *farthestDist > 0 ? farthestCell : -1;
+}
+
+template <int CellCount>
+int MazeGraph<CellCount>::direction(int fromCell, int toCell) const
+{
+  // by row first, in a maze one cell wide every step is 1 apart
+  int rowOffset = toCell / _width - fromCell / _width;
+  return rowOffset < 0 ? 2 : rowOffset > 0 ? 3 : toCell < fromCell ? 0 : 1;
+}
+
+template <int CellCount>
+int MazeGraph<CellCount>::otherEnd(int node, int dir) const
+{
+  const Edge &edge = _edges[_nodeEdges[node * 4 + dir]];
+  bool forward = edge.nodes[0] == node && edge.dirs[0] == dir;
+  return edge.nodes[forward ? 1 : 0];
+}
+
+// direction the edge leaving node in dir arrives at its other end from
+template <int CellCount>
+int MazeGraph<CellCount>::arrivalDir(int node, int dir) const
+{
+  const Edge &edge = _edges[_nodeEdges[node * 4 + dir]];
+  bool forward = edge.nodes[0] == node && edge.dirs[0] == dir;
+  return edge.dirs[forward ? 1 : 0];
+}
+
+// Turns a corridor cell into a node: its edge now ends there and a new edge takes the rest of the
+// corridor. The new node and edge come last, so mergeLastSplit() can undo the latest split. In a
+// pocket the new node hangs between the corridor's ends, with the lower one as its deepest child.
+template <int CellCount>
+void MazeGraph<CellCount>::splitAt(int cell)
+{
+  int edgeIndex = ~_cellSlots[cell];
+  Edge &edge = _edges[edgeIndex];
+  int step = 0;
+  while (_edgeCells[edge.firstCell + step] != cell)
+  {
+    step++;
+  }
+  int prev = step > 0 ? _edgeCells[edge.firstCell + step - 1] : _nodeCells[edge.nodes[0]];
+  int next = step + 2 < edge.length ? _edgeCells[edge.firstCell + step + 1] : _nodeCells[edge.nodes[1]];
+
+  int node = _nodeCount++;
+  _nodeCells[node] = cell;
+  _cellSlots[cell] = node;
+  for (int dir = 0; dir < 4; dir++)
+  {
+    _nodeEdges[node * 4 + dir] = -1;
+  }
+  int toPrev = direction(cell, prev);
+  int toNext = direction(cell, next);
+  _pocketLinks[node] = NoLink | (NoLink << 4);
+  _pocketDepths[node] = 0;
+  if (pocketParent(edge.nodes[0]) == edge.dirs[0] && edge.nodes[0] != edge.nodes[1])
+  {
+    _pocketLinks[node] = toNext | (toPrev << 4);
+    _pocketDepths[node] = step + 1 + _pocketDepths[edge.nodes[0]];
+  }
+  else if (pocketParent(edge.nodes[1]) == edge.dirs[1] && edge.nodes[0] != edge.nodes[1])
+  {
+    _pocketLinks[node] = toPrev | (toNext << 4);
+    _pocketDepths[node] = edge.length - step - 1 + _pocketDepths[edge.nodes[1]];
+  }
+
+  int restIndex = _edgeCount++;
+  Edge &rest = _edges[restIndex];
+  rest.nodes[0] = node;
+  rest.dirs[0] = toNext;
+  rest.nodes[1] = edge.nodes[1];
+  rest.dirs[1] = edge.dirs[1];
+  rest.firstCell = edge.firstCell + step + 1;
+  rest.length = edge.length - step - 1;
+  for (int i = 0; i < rest.length - 1; i++)
+  {
+    _cellSlots[_edgeCells[rest.firstCell + i]] = ~restIndex;
+  }
+
+  edge.nodes[1] = node;
+  edge.dirs[1] = toPrev;
+  edge.length = step + 1;
+  _nodeEdges[node * 4 + edge.dirs[1]] = edgeIndex;
+  _nodeEdges[node * 4 + rest.dirs[0]] = restIndex;
+  _nodeEdges[rest.nodes[1] * 4 + rest.dirs[1]] = restIndex;
+}
+
+template <int CellCount>
+void MazeGraph<CellCount>::mergeLastSplit()
+{
+  int node = --_nodeCount;
+  int restIndex = --_edgeCount;
+  const Edge &rest = _edges[restIndex];
+  int edgeIndex = -1;
+  for (int dir = 0; dir < 4; dir++)
+  {
+    int e = _nodeEdges[node * 4 + dir];
+    if (e >= 0 && e != restIndex)
+    {
+      edgeIndex = e;
+    }
+  }
+
+  Edge &edge = _edges[edgeIndex];
+  int cell = _nodeCells[node];
+  _cellSlots[cell] = ~edgeIndex;
+  for (int i = 0; i < rest.length - 1; i++)
+  {
+    _cellSlots[_edgeCells[rest.firstCell + i]] = ~edgeIndex;
+  }
+  edge.nodes[1] = rest.nodes[1];
+  edge.dirs[1] = rest.dirs[1];
+  edge.length += rest.length;
+  _nodeEdges[rest.nodes[1] * 4 + rest.dirs[1]] = edgeIndex;
+}
+
+// an edge is blocked if any of its cells or the node it leads to is
+template <int CellCount>
+bool MazeGraph<CellCount>::isBlocked(int edge, int node, const int *blockedCells, int blockedCount) const
+{
+  for (int i = 0; i < blockedCount; i++)
+  {
+    int slot = _cellSlots[blockedCells[i]];
+    if (slot == node || slot == ~edge)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the corridor cells from node out along dir, then the node at the other end
+template <int CellCount>
+template <typename Path>
+void MazeGraph<CellCount>::appendArc(int node, int dir, Path *path) const
+{
+  const Edge &edge = _edges[_nodeEdges[node * 4 + dir]];
+  bool forward = edge.nodes[0] == node && edge.dirs[0] == dir;
+  for (int i = 0; i < edge.length - 1; i++)
+  {
+    path->push_back(_edgeCells[edge.firstCell + (forward ? i : edge.length - 2 - i)]);
+  }
+  path->push_back(_nodeCells[edge.nodes[forward ? 1 : 0]]);
+}
+
+template <int CellCount>
+void MazeGraph<CellCount>::beginSearch()
+{
+  // stamps wrapped, clear stale marks so they can't match the new stamp
+  if (++_searchStamp == 0)
+  {
+    memset(_visitedStamps.data(), 0, _capacity * sizeof(uint16_t));
+    memset(_markStamps.data(), 0, _capacity * sizeof(uint16_t));
+    _searchStamp = 1;
+  }
+}
+
+// binary min-heap on dists over two parallel arrays
+template <int CellCount>
+void MazeGraph<CellCount>::heapPush(int *nodes, int *dists, int &size, int node, int dist)
+{
+  int i = size++;
+  while (i > 0 && dists[(i - 1) / 2] > dist)
+  {
+    nodes[i] = nodes[(i - 1) / 2];
+    dists[i] = dists[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  nodes[i] = node;
+  dists[i] = dist;
+}
+
+template <int CellCount>
+void MazeGraph<CellCount>::heapPop(int *nodes, int *dists, int &size, int &node, int &dist)
+{
+  node = nodes[0];
+  dist = dists[0];
+  int lastNode = nodes[--size];
+  int lastDist = dists[size];
+  int i = 0;
+  while (2 * i + 1 < size)
+  {
+    int child = 2 * i + 1;
+    if (child + 1 < size && dists[child + 1] < dists[child])
+    {
+      child++;
+    }
+    if (dists[child] >= lastDist)
+    {
+      break;
+    }
+    nodes[i] = nodes[child];
+    dists[i] = dists[child];
+    i = child;
+  }
+  nodes[i] = lastNode;
+  dists[i] = lastDist;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_buffer.h"
+
+// Path of cell indexes (y * width + x) in a fixed capacity ring buffer, so both ends push and pop in
+// O(1) and keeping only the first steps is O(1) too. Steps are in walking order, the next one at
+// front(). A fixed capacity path is a plain value with no heap at all; a DynamicSize one allocates
+// its ring once in allocate(). Callers keep paths within capacity, the maze's cell count is always
+// enough for a simple path.
+template <int Capacity = DynamicSize, typename Index = uint16_t>
+class MazePath
+{
+private:
+  MazeBuffer<Index, Capacity> _cells;
+  int _capacity = Capacity;
+  int _head = 0; // ring position of front()
+  int _size = 0;
+
+public:
+  void allocate(int capacity)
+  {
+    _cells.allocate(capacity);
+    _capacity = capacity;
+    clear();
+  }
+
+  int capacity() const { return _capacity; }
+  int size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  void clear()
+  {
+    _head = 0;
+    _size = 0;
+  }
+
+  int front() const { return _cells[_head]; }
+  int back() const { return _cells[wrap(_head + _size - 1)]; }
+  int operator[](int i) const { return _cells[wrap(_head + i)]; }
+
+  void push_back(int cell) { _cells[wrap(_head + _size++)] = (Index)cell; }
+  void push_front(int cell)
+  {
+    _head = _head == 0 ? _capacity - 1 : _head - 1;
+    _cells[_head] = (Index)cell;
+    _size++;
+  }
+  void pop_back() { _size--; }
+  void pop_front()
+  {
+    _head = wrap(_head + 1);
+    _size--;
+  }
+
+  // keeps the first steps
+  void truncate(int size) { _size = min(_size, size); }
+
+private:
+  // positions are at most one lap past the end
+  int wrap(int position) const { return position >= _capacity ? position - _capacity : position; }
+};
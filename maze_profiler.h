@@ -0,0 +1,221 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Build with -D MAZE_PROFILING=1 to time the engine's hot paths. Otherwise the MAZE_PROFILE_* macros
+// expand to nothing and no profiler is kept.
+#ifndef MAZE_PROFILING
+#define MAZE_PROFILING 0
+#endif
+// -D MAZE_COUNT_NODES=1 without MAZE_PROFILING keeps only a global count of nodes expanded
+#ifndef MAZE_COUNT_NODES
+#define MAZE_COUNT_NODES 0
+#endif
+
+#if MAZE_PROFILING
+
+#ifdef ESP_PLATFORM
+// CPU cycles, wraps every few seconds but only differences are kept
+inline uint32_t profileTicks() { return ESP.getCycleCount(); }
+inline uint32_t profileTicksPerUs() { return getCpuFrequencyMhz(); }
+#else
+// nanoseconds on host
+inline uint32_t profileTicks() { return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+inline uint32_t profileTicksPerUs() { return 1000; }
+#endif
+
+enum class ProfilePhase : uint8_t
+{
+  MoveRunner,
+  MoveSentry,
+  FindPathDfs,
+  FindLongestPathBfs,
+  DrawMaze,
+  GenerateMaze,
+  Show,
+  Count
+};
+
+static const char *ProfilePhaseNames[(int)ProfilePhase::Count] = {
+    "moveRunner", "moveSentry", "findPathDfs", "findLongestPathBfs", "drawMaze", "generateMaze", "show"};
+
+// Per phase call counts, min/max/total ticks, nodes expanded by searches and a histogram of log2
+// ticks, plus the last RingSize calls in order. Phases nest: a phase's nodes include those of the
+// searches it ran. Not synchronized: each profiler is written by one task at a time, so the engine
+// keeps a second one for building the next maze and merges it in from the display task.
+class MazeProfiler
+{
+public:
+  static const int HistogramBuckets = 32; // bucket b counts calls of [2^b, 2^(b+1)) ticks
+  static const int RingSize = 128;
+
+  struct PhaseStats
+  {
+    uint32_t calls = 0;
+    uint32_t minTicks = UINT32_MAX;
+    uint32_t maxTicks = 0;
+    uint64_t totalTicks = 0;
+    uint64_t nodes = 0;
+    uint32_t histogram[HistogramBuckets] = {};
+  };
+
+  struct Sample
+  {
+    uint32_t startTick;
+    uint32_t ticks;
+    uint32_t nodes;
+    ProfilePhase phase;
+  };
+
+private:
+  PhaseStats _phases[(int)ProfilePhase::Count];
+  Sample _ring[RingSize];
+  uint32_t _samples = 0; // total recorded, the newest is at (_samples - 1) % RingSize
+  uint32_t _nodes = 0;   // running count, phases keep the difference across their call
+
+public:
+  uint32_t nodeCount() const { return _nodes; }
+  void addNodes(uint32_t count) { _nodes += count; }
+
+  void record(ProfilePhase phase, uint32_t startTick, uint32_t ticks, uint32_t nodes)
+  {
+    PhaseStats &stats = _phases[(int)phase];
+    stats.calls++;
+    stats.minTicks = min(stats.minTicks, ticks);
+    stats.maxTicks = max(stats.maxTicks, ticks);
+    stats.totalTicks += ticks;
+    stats.nodes += nodes;
+    stats.histogram[ticks == 0 ? 0 : 31 - __builtin_clz(ticks)]++;
+    _ring[_samples++ % RingSize] = {startTick, ticks, nodes, phase};
+  }
+
+  const PhaseStats &getStats(ProfilePhase phase) const { return _phases[(int)phase]; }
+
+  // adds other's stats, and its recent calls after this one's
+  void merge(const MazeProfiler &other);
+
+  void reset()
+  {
+    for (PhaseStats &stats : _phases)
+    {
+      stats = PhaseStats();
+    }
+    _samples = 0;
+  }
+
+  // one line per phase, times in microseconds, to anything with printf() such as Serial
+  template <typename Out>
+  void printSummary(Out &out) const;
+  // everything including histograms and the recent calls, ticks are converted with ticks_per_us
+  template <typename Out>
+  void printJson(Out &out) const;
+};
+
+// times the enclosing scope as one call of phase
+class ProfileScope
+{
+private:
+  MazeProfiler &_profiler;
+  ProfilePhase _phase;
+  uint32_t _startTick;
+  uint32_t _startNodes;
+
+public:
+  ProfileScope(MazeProfiler &profiler, ProfilePhase phase)
+      : _profiler(profiler), _phase(phase), _startTick(profileTicks()), _startNodes(profiler.nodeCount()) {}
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+  ~ProfileScope() { _profiler.record(_phase, _startTick, profileTicks() - _startTick, _profiler.nodeCount() - _startNodes); }
+};
+
+void MazeProfiler::merge(const MazeProfiler &other)
+{
+  for (int p = 0; p < (int)ProfilePhase::Count; p++)
+  {
+    PhaseStats &stats = _phases[p];
+    const PhaseStats &add = other._phases[p];
+    stats.calls += add.calls;
+    stats.minTicks = min(stats.minTicks, add.minTicks);
+    stats.maxTicks = max(stats.maxTicks, add.maxTicks);
+    stats.totalTicks += add.totalTicks;
+    stats.nodes += add.nodes;
+    for (int b = 0; b < HistogramBuckets; b++)
+    {
+      stats.histogram[b] += add.histogram[b];
+    }
+  }
+  uint32_t first = other._samples > RingSize ? other._samples - RingSize : 0;
+  for (uint32_t i = first; i < other._samples; i++)
+  {
+    _ring[_samples++ % RingSize] = other._ring[i % RingSize];
+  }
+}
+
+template <typename Out>
+void MazeProfiler::printSummary(Out &out) const
+{
+  double ticksPerUs = profileTicksPerUs();
+  out.printf("%-20s %10s %10s %10s %10s %12s\n", "phase", "calls", "mean us", "min us", "max us", "nodes/call");
+  for (int p = 0; p < (int)ProfilePhase::Count; p++)
+  {
+    const PhaseStats &stats = _phases[p];
+    if (stats.calls == 0)
+    {
+      continue;
+    }
+    out.printf("%-20s %10u %10.2f %10.2f %10.2f %12.1f\n", ProfilePhaseNames[p], stats.calls,
+               stats.totalTicks / ticksPerUs / stats.calls, stats.minTicks / ticksPerUs, stats.maxTicks / ticksPerUs,
+               (double)stats.nodes / stats.calls);
+  }
+}
+
+template <typename Out>
+void MazeProfiler::printJson(Out &out) const
+{
+  out.printf("{\"ticks_per_us\": %u, \"phases\": {", profileTicksPerUs());
+  for (int p = 0; p < (int)ProfilePhase::Count; p++)
+  {
+    const PhaseStats &stats = _phases[p];
+    out.printf("%s\n  \"%s\": {\"calls\": %u, \"min_ticks\": %u, \"max_ticks\": %u, \"total_ticks\": %llu, \"nodes\": %llu, \"histogram_log2\": [",
+               p > 0 ? "," : "", ProfilePhaseNames[p], stats.calls, stats.calls > 0 ? stats.minTicks : 0, stats.maxTicks,
+               (unsigned long long)stats.totalTicks, (unsigned long long)stats.nodes);
+    for (int b = 0; b < HistogramBuckets; b++)
+    {
+      out.printf(b > 0 ? ", %u" : "%u", stats.histogram[b]);
+    }
+    out.printf("]}");
+  }
+
+  out.printf("\n}, \"recent\": [");
+  uint32_t first = _samples > RingSize ? _samples - RingSize : 0;
+  for (uint32_t i = first; i < _samples; i++)
+  {
+    const Sample &sample = _ring[i % RingSize];
+    out.printf("%s\n  {\"phase\": \"%s\", \"start_tick\": %u, \"ticks\": %u, \"nodes\": %u}", i > first ? "," : "",
+               ProfilePhaseNames[(int)sample.phase], sample.startTick, sample.ticks, sample.nodes);
+  }
+  out.printf("\n]}\n");
+}
+
+#define MAZE_PROFILE_SCOPE(profiler, phase) ProfileScope _profileScope((profiler), ProfilePhase::phase)
+#define MAZE_PROFILE_NODES(profiler, count) (profiler).addNodes(count)
+
+#elif MAZE_COUNT_NODES
+
+// node counts alone, for benchmarks that do their own timing and can't afford a clock read per call
+inline uint64_t &mazeNodeCount()
+{
+  static uint64_t count = 0;
+  return count;
+}
+
+#define MAZE_PROFILE_SCOPE(profiler, phase)
+#define MAZE_PROFILE_NODES(profiler, count) (mazeNodeCount() += (count))
+
+#else
+
+#define MAZE_PROFILE_SCOPE(profiler, phase)
+#define MAZE_PROFILE_NODES(profiler, count)
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+// xoshiro128** generator, small and fast on 32-bit cores. Each maze owns one, so a seed
+// reproduces a whole run and separate instances can be simulated in parallel.
+class MazeRandom
+{
+private:
+  uint32_t _state[4];
+
+  static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+public:
+  MazeRandom(uint64_t seed = 0) { setSeed(seed); }
+
+  void setSeed(uint64_t seed);
+  uint32_t next();
+
+  // the whole generator, so a recording can resume a run mid-stream
+  void getState(uint32_t state[4]) const
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      state[i] = _state[i];
+    }
+  }
+  void setState(const uint32_t state[4])
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      _state[i] = state[i];
+    }
+  }
+
+  // uniform in [0, bound), by multiply and shift rather than modulo
+  uint32_t uniform(uint32_t bound) { return ((uint64_t)next() * bound) >> 32; }
+  int uniform(int min, int max) { return min + (int)uniform((uint32_t)(max - min)); }
+};
+
+// expands the seed with splitmix64, which never yields the all-zero state
+void MazeRandom::setSeed(uint64_t seed)
+{
+  for (int i = 0; i < 4; i += 2)
+  {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    _state[i] = (uint32_t)z;
+    _state[i + 1] = (uint32_t)(z >> 32);
+  }
+}
+
+uint32_t MazeRandom::next()
+{
+  uint32_t result = rotl(_state[1] * 5, 7) * 9;
+  uint32_t t = _state[1] << 9;
+  _state[2] ^= _state[0];
+  _state[3] ^= _state[1];
+  _state[1] ^= _state[2];
+  _state[0] ^= _state[3];
+  _state[2] ^= t;
+  _state[3] = rotl(_state[3], 11);
+  return result;
+}
@@ -0,0 +1,506 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "maze_config.h"
+#include "maze_types.h"
+
+// Binary game recording, enough to re-drive the engine and check it does the same thing on every
+// tick. A stream is the magic bytes followed by records, each starting with one byte:
+//   0x00-0xEF  one step move: agent << 2 | index into Directions, for agents below StepAgents
+//   Ticks      varint n: n more update() calls, the records that follow happened in the last of them
+//   Jump       varint agent, varint cell index: a move that isn't a single step
+//   Remove     varint agent: runner caught
+//   Outcome    outcome byte, varint game ticks
+//   Maze       keyframe, written whenever a game starts: varint width, height, runner count, sentry
+//              count, config bytes, generator state (4 x 32-bit little endian), walls one bit per cell
+//              in row order, then varint exit cell + 1 and varint cell + 1 per agent (0 for none)
+//   Config     config bytes, setConfig() during a game
+//   Restart    init() or loadMaze(), a Maze record follows
+// Config bytes are runner fear, sense and speed, sentry sense and speed, flow field flag, generator.
+// A keyframe holds everything a game depends on, so a stream can be replayed from any of them.
+static const uint8_t MazeRecordMagic[4] = {'M', 'Z', 'R', '1'};
+static const int MazeRecordConfigSize = 7;
+
+enum MazeRecordTag : uint8_t
+{
+  MazeRecordTicks = 0xF0,
+  MazeRecordJump,
+  MazeRecordRemove,
+  MazeRecordOutcome,
+  MazeRecordMaze,
+  MazeRecordConfig,
+  MazeRecordRestart
+};
+
+// where a recording goes
+class MazeRecordSink
+{
+public:
+  virtual ~MazeRecordSink() {}
+  virtual void write(const uint8_t *data, int size) = 0;
+  // a stream can be replayed from the next byte written
+  virtual void beginKeyframe() {}
+};
+
+// Keeps the newest Capacity bytes of a stream, always starting at a keyframe so what's left can be
+// replayed. When full it drops whole games from the front. A game longer than the whole ring is lost
+// until the next keyframe.
+template <int Capacity, int MaxKeyframes = 32>
+class MazeRecordRing : public MazeRecordSink
+{
+private:
+  uint8_t _bytes[Capacity];
+  uint32_t _start = 0; // stream offsets, the ring holds [_start, _end)
+  uint32_t _end = 0;
+  uint32_t _keyframes[MaxKeyframes]; // stream offsets of the keyframes in the ring, oldest first
+  int _keyframeHead = 0;
+  int _keyframeCount = 0;
+  bool _synced = false; // false until a keyframe, and after losing the front of a game
+
+public:
+  void write(const uint8_t *data, int size) override;
+  void beginKeyframe() override;
+
+  int size() const { return _end - _start; }
+  void clear();
+
+  // the magic and the retained stream as hex lines, to anything with printf() such as Serial
+  template <typename Out>
+  void printHex(Out &out) const;
+
+private:
+  void dropFirstKeyframe();
+};
+
+// Encodes engine events into a sink. Tick counts are held back until the next record, so a run of
+// idle ticks costs a few bytes however long it is.
+class MazeRecorder
+{
+public:
+  static const int StepAgents = 60;
+
+private:
+  MazeRecordSink &_sink;
+  uint32_t _pendingTicks = 0;
+
+public:
+  MazeRecorder(MazeRecordSink &sink) : _sink(sink) {}
+
+  void tick(uint32_t ticks = 1) { _pendingTicks += ticks; }
+  void move(int agent, Location fromLoc, Location toLoc, int width);
+  void remove(int agent);
+  void outcome(GameOutcome outcome, uint32_t gameTicks);
+  void config(const MazeRunnerConfig &config);
+  void restart();
+  template <typename Grid>
+  void maze(const Grid &walls, int width, int height, int runnerCount, int sentryCount, const MazeRunnerConfig &config,
+            const uint32_t randomState[4], Location exitLoc, const Location *agentLocs);
+  // writes out ticks held back, only at the end of a stream
+  void flush() { flushTicks(); }
+
+  static int putVarint(uint8_t *out, uint32_t value);
+  static void putConfig(uint8_t *out, const MazeRunnerConfig &config);
+
+private:
+  void flushTicks();
+  void writeRecord(uint8_t tag, uint32_t first, uint32_t second = 0, int values = 1);
+  void writeLocation(Location loc, int width);
+};
+
+// everything in a Maze record but the agents, which follow at the reader's position
+struct MazeKeyframe
+{
+  int width;
+  int height;
+  int runnerCount;
+  int sentryCount;
+  MazeRunnerConfig config;
+  uint32_t randomState[4];
+  const uint8_t *wallBits; // into the stream
+  Location exitLoc;
+};
+
+// Walks the records of a stream without copying it. Reads return false past the end of the data.
+class MazeRecordReader
+{
+private:
+  const uint8_t *_data;
+  int _size;
+  int _pos;
+
+public:
+  MazeRecordReader(const uint8_t *data, int size, int pos = 0) : _data(data), _size(size), _pos(pos) {}
+
+  static bool hasMagic(const uint8_t *data, int size) { return size >= 4 && memcmp(data, MazeRecordMagic, 4) == 0; }
+
+  int position() const { return _pos; }
+  bool atEnd() const { return _pos >= _size; }
+
+  bool readByte(uint8_t &value);
+  bool readVarint(uint32_t &value);
+  bool readConfig(MazeRunnerConfig &config);
+  bool readLocation(Location &loc, int width);
+  bool readKeyframe(MazeKeyframe &keyframe);
+  // skips the rest of a record whose first byte was tag, agents included for a Maze record
+  bool skipRecord(uint8_t tag);
+};
+
+template <int Capacity, int MaxKeyframes>
+void MazeRecordRing<Capacity, MaxKeyframes>::write(const uint8_t *data, int size)
+{
+  if (!_synced)
+  {
+    return;
+  }
+
+  for (int i = 0; i < size; i++)
+  {
+    if (_end - _start == Capacity)
+    {
+      dropFirstKeyframe();
+      if (!_synced)
+      {
+        return;
+      }
+    }
+    _bytes[_end++ % Capacity] = data[i];
+  }
+}
+
+template <int Capacity, int MaxKeyframes>
+void MazeRecordRing<Capacity, MaxKeyframes>::beginKeyframe()
+{
+  if (!_synced)
+  {
+    _start = _end;
+    _synced = true;
+  }
+  if (_keyframeCount == MaxKeyframes)
+  {
+    dropFirstKeyframe();
+    _synced = true;
+  }
+  _keyframes[(_keyframeHead + _keyframeCount++) % MaxKeyframes] = _end;
+}
+
+template <int Capacity, int MaxKeyframes>
+void MazeRecordRing<Capacity, MaxKeyframes>::clear()
+{
+  _start = _end;
+  _keyframeCount = 0;
+  _synced = false;
+}
+
+// the ring then starts at the second keyframe, or is empty and waits for the next one
+template <int Capacity, int MaxKeyframes>
+void MazeRecordRing<Capacity, MaxKeyframes>::dropFirstKeyframe()
+{
+  _keyframeHead = (_keyframeHead + 1) % MaxKeyframes;
+  _keyframeCount--;
+  if (_keyframeCount > 0)
+  {
+    _start = _keyframes[_keyframeHead];
+    return;
+  }
+  clear();
+}
+
+template <int Capacity, int MaxKeyframes>
+template <typename Out>
+void MazeRecordRing<Capacity, MaxKeyframes>::printHex(Out &out) const
+{
+  for (int i = 0; i < 4; i++)
+  {
+    out.printf("%02X", MazeRecordMagic[i]);
+  }
+  for (uint32_t offset = _start; offset < _end; offset++)
+  {
+    out.printf((offset - _start) % 32 == 27 ? "%02X\n" : "%02X", _bytes[offset % Capacity]);
+  }
+  out.printf("\n");
+}
+
+int MazeRecorder::putVarint(uint8_t *out, uint32_t value)
+{
+  int size = 0;
+  while (value >= 0x80)
+  {
+    out[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[size++] = (uint8_t)value;
+  return size;
+}
+
+void MazeRecorder::putConfig(uint8_t *out, const MazeRunnerConfig &config)
+{
+  out[0] = config.runnerFear;
+  out[1] = config.runnerSense;
+  out[2] = config.runnerSpeed;
+  out[3] = config.sentrySense;
+  out[4] = config.sentrySpeed;
+  out[5] = config.sentryFlowField;
+  out[6] = (uint8_t)config.mazeGenerator;
+}
+
+void MazeRecorder::flushTicks()
+{
+  if (_pendingTicks > 0)
+  {
+    uint32_t ticks = _pendingTicks;
+    _pendingTicks = 0;
+    writeRecord(MazeRecordTicks, ticks);
+  }
+}
+
+void MazeRecorder::writeRecord(uint8_t tag, uint32_t first, uint32_t second, int values)
+{
+  uint8_t buffer[11];
+  int size = 0;
+  buffer[size++] = tag;
+  size += putVarint(buffer + size, first);
+  if (values > 1)
+  {
+    size += putVarint(buffer + size, second);
+  }
+  _sink.write(buffer, size);
+}
+
+void MazeRecorder::writeLocation(Location loc, int width)
+{
+  uint8_t buffer[5];
+  _sink.write(buffer, putVarint(buffer, loc == NullLocation ? 0 : loc.y * width + loc.x + 1));
+}
+
+void MazeRecorder::move(int agent, Location fromLoc, Location toLoc, int width)
+{
+  flushTicks();
+  Direction step = {toLoc.x - fromLoc.x, toLoc.y - fromLoc.y};
+  for (int d = 0; d < 4 && agent < StepAgents; d++)
+  {
+    if (step == Directions[d])
+    {
+      uint8_t move = agent << 2 | d;
+      _sink.write(&move, 1);
+      return;
+    }
+  }
+  writeRecord(MazeRecordJump, agent, toLoc.y * width + toLoc.x, 2);
+}
+
+void MazeRecorder::remove(int agent)
+{
+  flushTicks();
+  writeRecord(MazeRecordRemove, agent);
+}
+
+void MazeRecorder::outcome(GameOutcome outcome, uint32_t gameTicks)
+{
+  flushTicks();
+  uint8_t buffer[7] = {MazeRecordOutcome, (uint8_t)outcome};
+  _sink.write(buffer, 2 + putVarint(buffer + 2, gameTicks));
+}
+
+void MazeRecorder::config(const MazeRunnerConfig &config)
+{
+  flushTicks();
+  uint8_t buffer[1 + MazeRecordConfigSize] = {MazeRecordConfig};
+  putConfig(buffer + 1, config);
+  _sink.write(buffer, sizeof(buffer));
+}
+
+void MazeRecorder::restart()
+{
+  flushTicks();
+  _sink.beginKeyframe();
+  uint8_t tag = MazeRecordRestart;
+  _sink.write(&tag, 1);
+}
+
+// O(cells) for the walls, once per game
+template <typename Grid>
+void MazeRecorder::maze(const Grid &walls, int width, int height, int runnerCount, int sentryCount, const MazeRunnerConfig &config,
+                        const uint32_t randomState[4], Location exitLoc, const Location *agentLocs)
+{
+  flushTicks();
+  _sink.beginKeyframe();
+
+  uint8_t buffer[1 + 4 * 5 + MazeRecordConfigSize + 16];
+  int size = 0;
+  buffer[size++] = MazeRecordMaze;
+  size += putVarint(buffer + size, width);
+  size += putVarint(buffer + size, height);
+  size += putVarint(buffer + size, runnerCount);
+  size += putVarint(buffer + size, sentryCount);
+  putConfig(buffer + size, config);
+  size += MazeRecordConfigSize;
+  for (int i = 0; i < 4; i++)
+  {
+    for (int b = 0; b < 4; b++)
+    {
+      buffer[size++] = (uint8_t)(randomState[i] >> (8 * b));
+    }
+  }
+  _sink.write(buffer, size);
+
+  uint8_t bits = 0;
+  int cell = 0;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++, cell++)
+    {
+      bits |= walls.get(x, y) << (cell % 8);
+      if (cell % 8 == 7)
+      {
+        _sink.write(&bits, 1);
+        bits = 0;
+      }
+    }
+  }
+  if (cell % 8 != 0)
+  {
+    _sink.write(&bits, 1);
+  }
+
+  writeLocation(exitLoc, width);
+  for (int agent = 0; agent < runnerCount + sentryCount; agent++)
+  {
+    writeLocation(agentLocs[agent], width);
+  }
+}
+
+bool MazeRecordReader::readByte(uint8_t &value)
+{
+  if (_pos >= _size)
+  {
+    return false;
+  }
+  value = _data[_pos++];
+  return true;
+}
+
+bool MazeRecordReader::readVarint(uint32_t &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t byte;
+    if (!readByte(byte))
+    {
+      return false;
+    }
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (byte < 0x80)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MazeRecordReader::readConfig(MazeRunnerConfig &config)
+{
+  if (_size - _pos < MazeRecordConfigSize)
+  {
+    return false;
+  }
+  const uint8_t *bytes = _data + _pos;
+  config.runnerFear = bytes[0];
+  config.runnerSense = bytes[1];
+  config.runnerSpeed = bytes[2];
+  config.sentrySense = bytes[3];
+  config.sentrySpeed = bytes[4];
+  config.sentryFlowField = bytes[5] != 0;
+  config.mazeGenerator = (MazeGenerator)bytes[6];
+  _pos += MazeRecordConfigSize;
+  return true;
+}
+
+bool MazeRecordReader::readLocation(Location &loc, int width)
+{
+  uint32_t value;
+  if (!readVarint(value))
+  {
+    return false;
+  }
+  loc = value == 0 ? NullLocation : Location{(int)(value - 1) % width, (int)(value - 1) / width};
+  return true;
+}
+
+bool MazeRecordReader::readKeyframe(MazeKeyframe &keyframe)
+{
+  uint32_t values[4];
+  for (uint32_t &value : values)
+  {
+    if (!readVarint(value))
+    {
+      return false;
+    }
+  }
+  keyframe.width = values[0];
+  keyframe.height = values[1];
+  keyframe.runnerCount = values[2];
+  keyframe.sentryCount = values[3];
+  if (keyframe.width <= 0 || keyframe.height <= 0 || !readConfig(keyframe.config) || _size - _pos < 16)
+  {
+    return false;
+  }
+
+  for (int i = 0; i < 4; i++)
+  {
+    const uint8_t *bytes = _data + _pos + 4 * i;
+    keyframe.randomState[i] = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+  }
+  _pos += 16;
+
+  int wallBytes = (keyframe.width * keyframe.height + 7) / 8;
+  if (_size - _pos < wallBytes)
+  {
+    return false;
+  }
+  keyframe.wallBits = _data + _pos;
+  _pos += wallBytes;
+  return readLocation(keyframe.exitLoc, keyframe.width);
+}
+
+bool MazeRecordReader::skipRecord(uint8_t tag)
+{
+  uint32_t value;
+  uint8_t byte;
+  switch (tag)
+  {
+  case MazeRecordTicks:
+  case MazeRecordRemove:
+    return readVarint(value);
+  case MazeRecordJump:
+    return readVarint(value) && readVarint(value);
+  case MazeRecordOutcome:
+    return readByte(byte) && readVarint(value);
+  case MazeRecordConfig:
+  {
+    MazeRunnerConfig config;
+    return readConfig(config);
+  }
+  case MazeRecordMaze:
+  {
+    MazeKeyframe keyframe;
+    if (!readKeyframe(keyframe))
+    {
+      return false;
+    }
+    for (int agent = 0; agent < keyframe.runnerCount + keyframe.sentryCount; agent++)
+    {
+      if (!readVarint(value))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  case MazeRecordRestart:
+    return true;
+  default:
+    return tag < MazeRecordTicks; // one step moves are a single byte
+  }
+}
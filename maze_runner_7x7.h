@@ -3,12 +3,26 @@
 #include <Adafruit_NeoPixel.h>
 
 #include "display_task_handler.h"
+#include "frame_scheduler.h"
 #include "maze_runner_lib.h"
 
+// maze size in cells, anything bigger than the panel is shown through a view that follows the runner
+#ifndef MAZE_WIDTH
+#define MAZE_WIDTH 7
+#endif
+#ifndef MAZE_HEIGHT
+#define MAZE_HEIGHT 7
+#endif
+
 class MazeRunner7x7TaskHandler : public DisplayTaskHandler
 {
 private:
     const int MAZE_DELAY_MS = 60;
+    const int MAZE_MAX_STEPS_PER_FRAME = 4;
+    const uint32_t MAZE_MAX_IDLE_STEPS = 8; // longest sleep, so commands still apply within half a second
+    const uint32_t FRAME_STATS_LOG_FRAMES = 1000; // a minute or more
+    const int TEXT_FRAMES_PER_COLUMN = 2;
+    static const int RECORD_RING_SIZE = 4096; // the last 20 or so games
     const uint32_t BLACK = Adafruit_NeoPixel::Color(0x00, 0x00, 0x00);
     const uint32_t RED = Adafruit_NeoPixel::Color(0xFF, 0x00, 0x00);
     const uint32_t ORANGE = Adafruit_NeoPixel::Color(0xCC, 0x44, 0x00);
@@ -23,19 +37,70 @@ private:
     static const uint8_t BLUE_LED_PIN = 13;
     static const int WIDTH = 7;
     static const int HEIGHT = 7;
+    static const int VIEW_MARGIN = 2; // the runner stays in the middle 3x3 of a large maze
+    // keyframes hold the walls at a bit per cell, so large mazes aren't recorded
+    static const bool RECORD_GAMES = MAZE_WIDTH * MAZE_HEIGHT / 8 <= RECORD_RING_SIZE / 4;
+    static_assert(MAZE_WIDTH >= WIDTH && MAZE_HEIGHT >= HEIGHT, "The maze must fill the panel");
+    // a maze bigger than the panel is sized at run time, so its buffers come from the heap rather
+    // than being fixed arrays inside the engine
+    static const bool MAZE_ON_HEAP = MAZE_WIDTH * MAZE_HEIGHT > WIDTH * HEIGHT;
+
+    // draws straight into the NeoPixel buffers, inlined into the maze engine, and keeps a copy of the
+    // maze so pixels under the text can be restored when it moves on
+    struct Renderer
+    {
+        MazeRunner7x7TaskHandler *handler;
+
+        void drawPixel(int x, int y, uint32_t c)
+        {
+            handler->_mazePixels[y * WIDTH + x] = c;
+            if (!handler->_text.covers(x, y))
+            {
+                handler->_matrix.setPixelColor(y * WIDTH + x, c);
+            }
+        }
+
+        void setStatus(uint32_t c)
+        {
+            handler->_rgbLed.setPixelColor(0, c);
+            if (c == handler->PURPLE)
+            {
+                digitalWrite(BLUE_LED_PIN, true);
+            }
+        }
+    };
 
     Adafruit_NeoPixel _matrix;
     Adafruit_NeoPixel _rgbLed;
-    MazeRunner *_mazeRunner;
+    using MazeEngine = MazeRunnerEngine<MAZE_ON_HEAP ? DynamicSize : MAZE_WIDTH, MAZE_ON_HEAP ? DynamicSize : MAZE_HEIGHT, Renderer>;
+    MazeEngine *_mazeRunner;
+    uint32_t _mazePixels[WIDTH * HEIGHT] = {};
+    TextLayer<WIDTH, HEIGHT, MaxMessageSize> _text;
+    MazeRecordRing<RECORD_RING_SIZE> _recording;
+    MazeRecorder _recorder;
+    TaskHandle_t _prepareTaskHandle = NULL;
+    FrameScheduler _scheduler;
+    bool _showPending = false;
+    bool _reseedPending = false; // applied once no next maze is being built
+    uint32_t _pendingSeed = 0;
 
 public:
-    MazeRunner7x7TaskHandler() : _rgbLed(1, RGB_LED_PIN), _matrix(WIDTH * HEIGHT, RGB_LED_MATRIX_PIN) {}
+    MazeRunner7x7TaskHandler() : _matrix(WIDTH * HEIGHT, RGB_LED_MATRIX_PIN), _rgbLed(1, RGB_LED_PIN), _text(TEXT_FRAMES_PER_COLUMN), _recorder(_recording), _scheduler(MAZE_DELAY_MS, MAZE_MAX_STEPS_PER_FRAME) {}
 
     bool createTask() override;
-    void setDisplay(bool display) override;
 
 private:
     void task(void *parameters) override;
+    void applyCommand(const DisplayCommand &command) override;
+    void prepareTask();
+    bool drawText();
+    void logFrameStats();
+    void handleSerialCommand(int command);
+
+    static void prepareTaskWrapper(void *parameters)
+    {
+        static_cast<MazeRunner7x7TaskHandler *>(parameters)->prepareTask();
+    }
 };
 
 bool MazeRunner7x7TaskHandler::createTask()
@@ -62,45 +127,177 @@ bool MazeRunner7x7TaskHandler::createTask()
     _rgbLed.setPixelColor(0, GREEN);
     _rgbLed.show();
 
-    _mazeRunner = new MazeRunner(
-        WIDTH,
-        HEIGHT,
+    _mazeRunner = new MazeEngine(
+        MAZE_WIDTH,
+        MAZE_HEIGHT,
         BLACK,  // off
         ORANGE, // wall
         YELLOW, // runner
         RED,    // sentry
         PURPLE, // exit
-        [this](int x, int y, uint32_t c)
-        { _matrix.setPixelColor(y * WIDTH + x, c); },
-        [this](uint32_t c)
-        { _rgbLed.setPixelColor(0, c); if (c == PURPLE) { digitalWrite(BLUE_LED_PIN, true); } });
+        Renderer{this});
 
+    _mazeRunner->setViewport(WIDTH, HEIGHT, VIEW_MARGIN);
+    if (RECORD_GAMES)
+    {
+        _mazeRunner->setRecorder(&_recorder);
+    }
     _mazeRunner->init();
 
     log_i("Starting MazeRunner7x7Task");
     xTaskCreatePinnedToCore(taskWrapper, "MazeRunner7x7Task", 4096 * 4, this, 2, &_taskHandle, 0); // other Arduino tasks are on Core 1
+    // above the Arduino loopTask, which spins on Core 1 at priority 1 even with an empty loop(), so a
+    // build runs as soon as it's requested instead of sharing time slices. The task sleeps while idle.
+    xTaskCreatePinnedToCore(prepareTaskWrapper, "MazeRunner7x7Prepare", 4096 * 2, this, 2, &_prepareTaskHandle, 1);
 
     log_i("MazeRunner7x7 setup complete");
     return true;
 }
 
-void MazeRunner7x7TaskHandler::setDisplay(bool displayState)
+void MazeRunner7x7TaskHandler::applyCommand(const DisplayCommand &command)
 {
-    DisplayTaskHandler::setDisplay(displayState);
+    switch (command.type)
+    {
+    case DisplayCommandType::Display:
+        log_i("Setting display to %s", command.value ? "on" : "off");
+        digitalWrite(EN_PIN, command.value != 0); // turns off LDO for 7x7 matrix
+        break;
+    case DisplayCommandType::Brightness:
+        _matrix.setBrightness(command.value);
+        _showPending = true;
+        break;
+    case DisplayCommandType::Speed:
+        _scheduler.setPeriod(command.value);
+        break;
+    case DisplayCommandType::Reseed:
+        _reseedPending = true;
+        _pendingSeed = command.value;
+        break;
+    default:
+        break;
+    }
+    DisplayTaskHandler::applyCommand(command);
 
-    log_i("Setting display to %s", displayState ? "on" : "off");
-    digitalWrite(EN_PIN, displayState); // turns off LDO for 7x7 matrix
+    // rasterized once here, frames only scroll the cached columns
+    switch (command.type)
+    {
+    case DisplayCommandType::Message:
+        _text.setText(_message);
+        break;
+    case DisplayCommandType::TextMode:
+        _text.setMode(_textMode);
+        break;
+    default:
+        break;
+    }
 }
 
+// one simulation step per frame, more after a late frame, and at most one show(). While the maze is only
+// counting down the task sleeps through those steps instead of waking for each.
 void MazeRunner7x7TaskHandler::task(void *parameters)
 {
+    _scheduler.start();
     while (1)
     {
-        if (_display && _mazeRunner->update())
+        int steps = _scheduler.beginFrame();
+        drainCommands();
+
+        // the prepare task owns the engine's generator while a reset is pending
+        if (_reseedPending && !_mazeRunner->isResetPending())
+        {
+            _mazeRunner->setSeed(_pendingSeed);
+            _mazeRunner->init();
+            _reseedPending = false;
+        }
+
+        bool changed = _showPending;
+        _showPending = false;
+        for (int step = 0; _display && !_paused && step < steps; step++)
+        {
+            changed |= _mazeRunner->update();
+        }
+        if (_display)
+        {
+            changed |= drawText();
+        }
+
+        // sleep through steps that would only count down, the text scrolls every frame though
+        uint32_t idleSteps = 0;
+        if (_display && !_paused && !_text.isActive())
         {
+            idleSteps = min(_mazeRunner->ticksUntilChange(), MAZE_MAX_IDLE_STEPS);
+            _mazeRunner->skipTicks(idleSteps);
+        }
+        if (changed)
+        {
+            MAZE_PROFILE_SCOPE(_mazeRunner->profiler(), Show);
             _matrix.show();
             _rgbLed.show();
         }
-        delay(MAZE_DELAY_MS);
+        if (Serial.available() > 0)
+        {
+            handleSerialCommand(Serial.read());
+        }
+        _scheduler.endFrame(idleSteps);
+
+        if (_scheduler.getStats().frames >= FRAME_STATS_LOG_FRAMES)
+        {
+            logFrameStats();
+            _scheduler.resetStats();
+        }
+    }
+}
+
+// text pixels over the maze, or over black in replace mode, restoring the maze where the text leaves
+bool MazeRunner7x7TaskHandler::drawText()
+{
+    auto drawPixel = [this](int x, int y, bool lit)
+    {
+        uint32_t color = lit ? YELLOWGREEN : (_text.covers(x, y) ? BLACK : _mazePixels[y * WIDTH + x]);
+        _matrix.setPixelColor(y * WIDTH + x, color);
+    };
+    return _text.update(drawPixel);
+}
+
+void MazeRunner7x7TaskHandler::logFrameStats()
+{
+    const FrameScheduler::Stats &stats = _scheduler.getStats();
+    log_i("Frames: %u, steps: %u, idle steps: %u, dropped steps: %u, overruns: %u, work mean %u us, max %u us of %u us",
+          stats.frames, stats.steps, stats.idleSteps, stats.droppedSteps, stats.overruns,
+          (uint32_t)(stats.totalWorkUs / stats.frames), stats.maxWorkUs, _scheduler.periodUs());
+}
+
+// builds the next maze on the other core while the end of the last game is shown
+void MazeRunner7x7TaskHandler::prepareTask()
+{
+    while (1)
+    {
+        if (!_mazeRunner->prepareNextMaze())
+        {
+            delay(MAZE_DELAY_MS);
+        }
+    }
+}
+
+// 'd' prints the recording of the last games as hex, for maze_runner_replay verify. With the profiler
+// built in, 'p' prints a summary of the hot path timings, 'j' the full profile as JSON, 'r' resets it
+void MazeRunner7x7TaskHandler::handleSerialCommand(int command)
+{
+    switch (command)
+    {
+    case 'd':
+        _recording.printHex(Serial);
+        break;
+#if MAZE_PROFILING
+    case 'p':
+        _mazeRunner->profiler().printSummary(Serial);
+        break;
+    case 'j':
+        _mazeRunner->profiler().printJson(Serial);
+        break;
+    case 'r':
+        _mazeRunner->profiler().reset();
+        break;
+#endif
     }
 }
@@ -1,131 +1,285 @@
 #pragma once
 
 #include <Arduino.h>
-#include <queue>
-#include <stack>
-#include <tuple>
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+#include "bit_grid.h"
+#include "distance_field_cache.h"
+#include "flow_field.h"
+#include "maze_camera.h"
+#include "maze_buffer.h"
+#include "maze_config.h"
+#include "maze_graph.h"
+#include "maze_path.h"
+#include "maze_generators.h"
+#include "maze_profiler.h"
+#include "maze_recorder.h"
+#include "maze_random.h"
+#include "maze_types.h"
 
 using namespace std;
 
-struct Coordinate
+// Renderer policy for MazeRunnerEngine, any type with these members works:
+//   void drawPixel(int x, int y, uint32_t color); // in viewport coordinates, see setViewport()
+//   void setStatus(uint32_t color);
+// Dimensions are either both fixed at compile time, with all buffers in std::arrays, or both DynamicSize.
+template <int Width, int Height, typename Renderer>
+class MazeRunnerEngine
 {
-  int x;
-  int y;
-};
-
-bool operator==(const Coordinate &lhs, const Coordinate &rhs)
-{
-  return lhs.x == rhs.x && lhs.y == rhs.y;
-}
-
-bool operator!=(const Coordinate &lhs, const Coordinate &rhs)
-{
-  return !(lhs == rhs);
-}
-
-namespace std
-{
-  template <>
-  struct hash<Coordinate>
-  {
-    size_t operator()(const Coordinate &loc) const
-    {
-      return hash<int>()(loc.x) ^ hash<int>()(loc.y);
-    }
-  };
-}
-
-using Location = Coordinate;
-using Direction = Coordinate;
-
-const Location NullLocation = Location{-1, -1};
+  friend class MazeMicroBench; // host benchmarks time the private phases directly
 
-const Direction Left = {-1, 0};
-const Direction Right = {1, 0};
-const Direction Up = {0, -1};
-const Direction Down = {0, 1};
-const Direction Directions[] = {Left, Right, Up, Down};
+public:
+  static constexpr int CellCount = Width * Height; // DynamicSize for runtime sized mazes
+  static const int AllPairsMaxCells = 64;          // mazes this small keep a distance field for every cell
+  static const int DistanceFieldSlots = 4;          // fields kept on bigger mazes, or one per agent if more
+  static const int GraphSearchMinCells = 1024;     // mazes this big search long paths over the corridor graph
+  static const uint32_t NoPendingChange = UINT32_MAX; // nothing changes until init()
 
-class MazeRunner
-{
 private:
-  const uint8_t RunnerFear = 10; // extra sense when fleeing
-  const uint8_t RunnerSense = 2;
-  const uint8_t RunnerSpeed = 3;
-  const uint8_t SentrySense = 2;
-  const uint8_t SentrySpeed = 5;
+  using Grid = BitGrid<Width, Height>;
+  // packed 16-bit cell indexes when the size is known to fit, runtime sized mazes can be any size
+  using Path = MazePath<CellCount, typename conditional<CellCount != DynamicSize && CellCount <= 65536, uint16_t, uint32_t>::type>;
+  using Flow = FlowField<CellCount>;
+  // smaller fixed size mazes never build one, so they hold an empty runtime sized graph
+  using Graph = MazeGraph<CellCount == DynamicSize || CellCount >= GraphSearchMinCells ? CellCount : DynamicSize>;
+  using FieldCache = DistanceFieldCache<CellCount, CellCount == DynamicSize ? DynamicSize : (CellCount <= AllPairsMaxCells ? CellCount : DistanceFieldSlots)>;
+  static constexpr int SearchCapacity = CellCount == DynamicSize ? DynamicSize : 4 * CellCount + 1;
+
   const int GoalDelay = 10;
   const int CatchDelay = 30;
   const int ErrorDelay = 100;
+  const int BitboardSearchMinCells = 1024; // mazes this big search whole frontiers at once
+  const int MaxPlacementAttempts = 1000;   // random picks before falling back to a scan
 
   int _width;
   int _height;
-  bool **_mazeWalls;
+  MazeRunnerConfig _config;
+  Grid _mazeWalls;
   int _mazeExtraWallsToRemove = 1;
 
   uint32_t _pathColor;
   uint32_t _wallColor;
-
-  Location _runnerLoc = NullLocation;
-  Location _runnerSentryKnownLoc = NullLocation;
-  deque<Location> _runnerPath;
   uint32_t _runnerColor;
-  uint8_t _runnerCooldown = 0;
-  int _resetDelay = -1;
-
-  Location _sentryLoc = NullLocation;
-  Location _sentryExitKnownLoc = NullLocation;
-  deque<Location> _sentryPath;
   uint32_t _sentryColor;
-  uint8_t _sentryCooldown = 0;
-
   uint32_t _exitColor;
   Location _exitLoc = NullLocation;
+  Location _startLoc = NullLocation; // where the last game ended, the next maze grows from there
+  int _resetDelay = -1;
 
-  // function callback to draw pixels
-  std::function<void(int, int, uint32_t)> _drawPixel;
-  std::function<void(uint32_t)> _setStatus;
+  // The next game is built into these while the last one's end is shown, then swapped in. A build is
+  // requested when a game ends and claimed by prepareNextMaze(), from another task or thread, or
+  // from update() once the delay is over. update() runs no searches and draws no random numbers
+  // while a reset is pending, so the build has the search buffers and the generator to itself.
+  enum NextMazeState : uint8_t
+  {
+    NextMazeIdle,
+    NextMazeRequested,
+    NextMazeBuilding,
+    NextMazeReady
+  };
+  atomic<uint8_t> _nextMazeState{NextMazeIdle};
+  Grid _nextWalls;
+  Graph _nextGraph;
+  Location _nextExitLoc = NullLocation;
+  MazeBuffer<Location, DynamicSize> _nextAgentLocs; // NullLocation for agents that couldn't be placed
+  bool _nextMazeValid = false;
+
+  // agent state as parallel arrays indexed by agent, runners are [0, _runnerCount) and sentries follow
+  int _runnerCount;
+  int _sentryCount;
+  int _runnersLeft = 0;
+  MazeBuffer<Location, DynamicSize> _agentLocs;      // NullLocation once a runner is caught
+  MazeBuffer<Location, DynamicSize> _agentAvoidLocs; // runners: sentry last fled from, avoided when planning
+  MazeBuffer<uint8_t, DynamicSize> _agentCooldowns;
+  MazeBuffer<Path, DynamicSize> _agentPaths;
+  MazeBuffer<int, DynamicSize> _agentTargets;       // sentries in flow field mode: runner being chased, -1 if none
+  MazeBuffer<uint16_t, DynamicSize> _agentChaseSteps; // sentries in flow field mode: steps left to chase
+
+  // steps toward each runner, built when a sentry first chases it and repaired as the runner moves
+  MazeBuffer<Flow, DynamicSize> _runnerFlows;
+
+  // agents on each cell, so catches, sensing and drawing never compare agents pairwise
+  MazeBuffer<uint16_t, CellCount> _runnerCounts;
+  MazeBuffer<uint16_t, CellCount> _sentryCounts;
+
+  // reusable search buffers, sized once from the maze dimensions so searches don't allocate
+  uint16_t _searchStamp = 0;
+  MazeBuffer<uint16_t, CellCount> _visitedStamps; // cell was visited in the current search if its stamp matches _searchStamp
+  MazeBuffer<int, CellCount> _parentIndexes;      // cell index each cell was first reached from
+  MazeBuffer<int, SearchCapacity> _searchCells;   // fixed capacity queue/stack of cell indexes
+  MazeBuffer<int, SearchCapacity> _searchDists;   // distance from start of each entry in _searchCells
+  MazeBuffer<int, CellCount> _searchPathCells;    // current DFS path by depth
+
+  // bitboard search state, only words around the frontier are touched per layer
+  Grid _searchFrontier; // kept clear between searches
+  Grid _searchNext;
+  Grid _searchVisited; // word is valid for the current search if its stamp matches _searchStamp
+  Grid _searchBlocked; // sentry avoidance mask, kept clear between searches
+  MazeBuffer<uint16_t, Grid::WordCount> _visitedWordStamps;
+  MazeBuffer<bool, Grid::WordCount> _wordQueued; // word is already a candidate for the next layer
+  MazeBuffer<int, Grid::WordCount> _frontierWords; // indexes of the nonzero frontier words
+  MazeBuffer<int, Grid::WordCount> _nextWords;
+  MazeBuffer<int, Grid::WordCount> _candidateWords;
+
+  // distance fields from source cells, valid until the walls change in generateMaze()
+  FieldCache _distanceFields;
+
+  // junctions, dead ends and the corridors between them, built with the walls on large mazes
+  Graph _mazeGraph;
+
+  // cells changed since the last drawMaze(), everything in view is redrawn after init() or a camera move
+  MazeCamera _camera;
+  Grid _dirtyCells;
+  MazeBuffer<int, CellCount> _dirtyIndexes;
+  int _dirtyCount = 0;
+  bool _fullRedraw = true;
+
+  // outcome of the last finished game, for headless simulation
+  uint32_t _gameTicks = 0; // update() calls since init()
+  uint32_t _gamesFinished = 0;
+  GameOutcome _lastOutcome = GameOutcome::None;
+  uint32_t _lastGameTicks = 0;
+
+  Renderer _renderer;
+  MazeRandom _random;
+  MazeRecorder *_recorder = nullptr;
+
+#if MAZE_PROFILING
+  MazeProfiler _profiler;
+  // written by whichever task holds the next maze build, merged into _profiler when it's swapped in
+  MazeProfiler _prepareProfiler;
+#endif
 
 public:
-  MazeRunner(
+  MazeRunnerEngine(
       int width, int height,
       uint32_t pathColor, uint32_t wallColor,
       uint32_t runnerColor, uint32_t sentryColor,
       uint32_t exitColor,
-      std::function<void(int, int, uint32_t)> drawPixel,
-      std::function<void(uint32_t)> setStatus = nullptr);
+      Renderer renderer,
+      int runnerCount = 1, int sentryCount = 1);
+  MazeRunnerEngine(const MazeRunnerEngine &) = delete;
+  MazeRunnerEngine &operator=(const MazeRunnerEngine &) = delete;
+
+  void setSeed(uint64_t seed) { _random.setSeed(seed); }
+  void setConfig(const MazeRunnerConfig &config)
+  {
+    _config = config;
+    if (_recorder)
+    {
+      _recorder->config(config);
+    }
+  }
+  const MazeRunnerConfig &getConfig() const { return _config; }
+  // Draws only a viewWidth x viewHeight window of the maze, at (0, 0) for the renderer, that follows
+  // the first runner still in play and keeps it margin cells from the edges. Draw cost then depends on
+  // the view size, not the maze size. The default view is the whole maze.
+  void setViewport(int viewWidth, int viewHeight, int margin = 2);
+  const MazeCamera &camera() const { return _camera; }
+
+  int width() const { return Width != DynamicSize ? Width : _width; }
+  int height() const { return Height != DynamicSize ? Height : _height; }
+  int runnerCount() const { return _runnerCount; }
+  int sentryCount() const { return _sentryCount; }
 
   void init();
   bool update(); // returns true if any pixel changed
+  // Starts a game from a recorded keyframe instead of building one. Walls are one bit per cell in row
+  // order, agentLocs has one entry per agent. Must not run while another task may be in prepareNextMaze().
+  void loadMaze(const MazeRunnerConfig &config, const uint8_t *wallBits, Location exitLoc, const Location *agentLocs,
+                const uint32_t randomState[4]);
+  // every event from here on goes to recorder, nullptr stops recording
+  void setRecorder(MazeRecorder *recorder) { _recorder = recorder; }
+  // builds the requested next maze if no one has claimed it yet, returns false if there was nothing to do
+  bool prepareNextMaze();
+  bool isResetPending() const { return _resetDelay > 0; } // the last game's end is still shown
+  // update() calls from now that would only count down cooldowns or the reset delay, so they can be
+  // slept through or skipped
+  uint32_t ticksUntilChange() const;
+  // same as that many update() calls, at most ticksUntilChange()
+  void skipTicks(uint32_t ticks);
+
+  uint32_t getGamesFinished() const { return _gamesFinished; }
+  GameOutcome getLastOutcome() const { return _lastOutcome; }
+  uint32_t getLastGameTicks() const { return _lastGameTicks; }
+  uint32_t getDistanceFieldHits() const { return _distanceFields.hits(); }
+  uint32_t getDistanceFieldLookups() const { return _distanceFields.lookups(); }
+
+#if MAZE_PROFILING
+  MazeProfiler &profiler() { return _profiler; }
+#endif
 
 private:
-  bool moveRunner();
-  bool moveSentry();
+  void finishGame(GameOutcome outcome, Location endLoc, int resetDelay);
+  bool moveRunner(int agent);
+  bool moveSentry(int agent);
+  bool moveSentryAlongFlow(int agent);
+  void moveAgent(int agent, Location loc, MazeBuffer<uint16_t, CellCount> &counts);
+  void removeRunner(int agent);
   void drawMaze();
+  void drawCell(int x, int y);
+  void markDirty(Location loc);
 
+  // placements return false if there was no room, which ends the game as an error
+  bool buildNextMaze();
+  void swapInNextMaze();
   void generateMaze();
-  void placeRunner();
-  void placeSentry();
-  void placeExit();
-
-  deque<Location> findPathDfs(Location startLoc, Location endLoc, int maxSearchDistance = -1) { return findPathDfs(startLoc, NullLocation, endLoc, maxSearchDistance); }
-  deque<Location> findPathDfs(Location startLoc, Location sentryLoc, Location encLoc, int maxSearchDistance = -1);
-  deque<Location> findLongestPathBfs(Location startLoc, Location sentryLoc = NullLocation, int maxSearchDistance = -1);
+  void removeExtraWalls();
+  bool placeRunners();
+  bool placeSentries();
+  bool placeExit();
+  Location findOpenCell(Location avoidLoc);
+
+  // searches return true if a path was found, and write it to path if given
+  bool findPathDfs(Location startLoc, Location endLoc, int maxSearchDistance = -1, Path *path = nullptr) { return findPathDfs(startLoc, NullLocation, endLoc, maxSearchDistance, path); }
+  bool findPathDfs(Location startLoc, Location sentryLoc, Location endLoc, int maxSearchDistance = -1, Path *path = nullptr);
+  bool findLongestPathBfs(Location startLoc, Location sentryLoc = NullLocation, int maxSearchDistance = -1, Path *path = nullptr);
+  bool findPathBitboard(const Grid &walls, Location startLoc, Location sentryLoc, Location endLoc, int maxSearchDistance, Path *path,
+                        Location *farthestLoc = nullptr);
+  bool useBitboardSearch() { return width() * height() >= BitboardSearchMinCells; }
+  bool useGraphSearch() { return width() * height() >= GraphSearchMinCells; }
+  bool findPathGraph(Location startLoc, Location sentryLoc, Location endLoc, Path *path);
+  bool findPathToward(Location startLoc, Location endLoc, int maxSteps, Path *path);
+  int findFarthestCell(const Grid &walls, Location startLoc, int *farthestDist);
+  int findNearestOccupied(Location startLoc, const MazeBuffer<uint16_t, CellCount> &counts, int maxSteps);
+  int senseNearestAgent(Location startLoc, int firstAgent, int endAgent, const MazeBuffer<uint16_t, CellCount> &counts, int maxSteps);
+  const uint16_t *getDistanceField(Location sourceLoc, int maxSteps);
+  const uint16_t *addDistanceField(Location sourceLoc, int maxSteps);
+  void computeDistanceField(int sourceIndex, int radius, uint16_t *dists);
+  void eraseDistanceField(int sourceIndex, uint16_t *dists);
+  void beginSearch();
+  bool isVisited(int index) { return _visitedStamps[index] == _searchStamp; }
+  void markVisited(int index) { _visitedStamps[index] = _searchStamp; }
+  int toIndex(Location loc) { return loc.y * width() + loc.x; }
+  Location toLocation(int index) { return {index % width(), index / width()}; }
 
   bool isAdjacent(Location a, Location b) { return abs(a.x - b.x) + abs(a.y - b.y) == 1; }
   bool isWall(int x, int y);
   bool isWall(Location loc);
   bool isInMazeBounds(int x, int y);
   bool isInMazeBounds(Location loc);
-  int getAdjacentWallAndBorderCount(int x, int y);
-  int getAdjacentWallAndBorderCount(Location loc);
-  void shuffleDirections(Direction *list, int size);
+  const DirectionOrder &randomDirectionOrder() { return DirectionOrders[_random.uniform(24)]; }
 };
 
-MazeRunner::MazeRunner(int width, int height, uint32_t pathColor, uint32_t wallColor, uint32_t runnerColor, uint32_t sentryColor,
-                       uint32_t exitColor, std::function<void(int, int, uint32_t)> drawPixel, std::function<void(uint32_t)> setStatus)
+template <int Width, int Height, typename Renderer>
+MazeRunnerEngine<Width, Height, Renderer>::MazeRunnerEngine(int width, int height, uint32_t pathColor, uint32_t wallColor, uint32_t runnerColor,
+                                                            uint32_t sentryColor, uint32_t exitColor, Renderer renderer,
+                                                            int runnerCount, int sentryCount)
+    : _mazeWalls(width, height),
+      _nextWalls(width, height),
+      _searchFrontier(width, height),
+      _searchNext(width, height),
+      _searchVisited(width, height),
+      _searchBlocked(width, height),
+      _distanceFields(width * height, width * height <= AllPairsMaxCells ? width * height
+                                      : CellCount == DynamicSize ? max(DistanceFieldSlots, max(1, runnerCount) + max(0, sentryCount))
+                                                                 : DistanceFieldSlots),
+      _camera(width, height),
+      _dirtyCells(width, height),
+      _renderer(renderer),
+      _random(((uint64_t)esp_random() << 32) | esp_random())
 {
   _width = width;
   _height = height;
@@ -134,163 +288,378 @@ MazeRunner::MazeRunner(int width, int height, uint32_t pathColor, uint32_t wallC
   _runnerColor = runnerColor;
   _sentryColor = sentryColor;
   _exitColor = exitColor;
-  _drawPixel = drawPixel;
-  _setStatus = setStatus;
 
-  _mazeWalls = new bool *[_height];
-  for (int i = 0; i < _height; i++)
+  // DFS marks cells visited when popped, so a cell can be pushed once per neighbor
+  int cellCount = width * height;
+  _visitedStamps.allocate(cellCount);
+  _parentIndexes.allocate(cellCount);
+  _searchCells.allocate(4 * cellCount + 1);
+  _searchDists.allocate(4 * cellCount + 1);
+  _searchPathCells.allocate(cellCount);
+
+  int wordCount = _mazeWalls.wordsPerRow() * height;
+  _visitedWordStamps.allocate(wordCount);
+  _wordQueued.allocate(wordCount);
+  _frontierWords.allocate(wordCount);
+  _nextWords.allocate(wordCount);
+  _candidateWords.allocate(wordCount);
+  _dirtyIndexes.allocate(cellCount);
+  if (useGraphSearch())
+  {
+    _mazeGraph.allocate(cellCount);
+    _nextGraph.allocate(cellCount);
+  }
+
+  // sentries drawn in the path color are disabled
+  _runnerCount = max(1, runnerCount);
+  _sentryCount = sentryColor == pathColor ? 0 : max(0, sentryCount);
+  int agentCount = _runnerCount + _sentryCount;
+  _agentLocs.allocate(agentCount);
+  _nextAgentLocs.allocate(agentCount);
+  _agentAvoidLocs.allocate(agentCount);
+  _agentCooldowns.allocate(agentCount);
+  _agentPaths.allocate(agentCount);
+  for (int i = 0; i < agentCount; i++)
+  {
+    _agentPaths[i].allocate(cellCount);
+  }
+  _agentTargets.allocate(agentCount);
+  _agentChaseSteps.allocate(agentCount);
+  _runnerFlows.allocate(_runnerCount);
+  for (int i = 0; i < _runnerCount; i++)
+  {
+    _runnerFlows[i].allocate(cellCount);
+  }
+  for (int i = 0; i < agentCount; i++)
   {
-    _mazeWalls[i] = new bool[_width];
+    _agentLocs[i] = NullLocation;
+    _nextAgentLocs[i] = NullLocation;
+    _agentAvoidLocs[i] = NullLocation;
+    _agentTargets[i] = -1;
   }
+  _runnerCounts.allocate(cellCount);
+  _sentryCounts.allocate(cellCount);
 }
 
-void MazeRunner::init()
+// builds and starts a new game right away, must not run while another task may be in prepareNextMaze()
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::init()
 {
-  ("Initializing maze");
+  log_d("Initializing maze");
 
-  generateMaze();
-  placeRunner();
-  placeSentry();
-  placeExit();
+  if (_recorder)
+  {
+    _recorder->restart();
+  }
+  _resetDelay = -1;
+  _nextMazeState.store(NextMazeBuilding, memory_order_relaxed);
+  _nextMazeValid = buildNextMaze();
+  swapInNextMaze();
+}
 
-  log_v("*--------*");
-  for (int y = 0; y < _height; y++)
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::setViewport(int viewWidth, int viewHeight, int margin)
+{
+  _camera.setView(viewWidth, viewHeight, margin);
+  if (_agentLocs[0] != NullLocation)
   {
-    String row = "|";
-    for (int x = 0; x < _width; x++)
+    _camera.center(_agentLocs[0]);
+  }
+  _fullRedraw = true;
+}
+
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::loadMaze(const MazeRunnerConfig &config, const uint8_t *wallBits, Location exitLoc,
+                                                         const Location *agentLocs, const uint32_t randomState[4])
+{
+  if (_recorder)
+  {
+    _recorder->restart();
+  }
+  _resetDelay = -1;
+  _nextMazeState.store(NextMazeBuilding, memory_order_relaxed);
+
+  _config = config;
+  for (int y = 0; y < height(); y++)
+  {
+    for (int x = 0; x < width(); x++)
     {
-      char c = isWall(x, y) ? '#' : ' ';
-      c = (_runnerLoc.x == x && _runnerLoc.y == y) ? 'S' : c;
-      c = (_sentryLoc.x == x && _sentryLoc.y == y) ? 'X' : c;
-      c = (_exitLoc.x == x && _exitLoc.y == y) ? 'E' : c;
-      row += c;
+      int cell = y * width() + x;
+      _nextWalls.set(x, y, (wallBits[cell / 8] >> (cell % 8)) & 1);
     }
-    row += "|";
-    log_v("%s", row);
   }
-  log_v("*--------*");
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
+  {
+    _nextAgentLocs[agent] = agentLocs[agent];
+  }
+  if (useGraphSearch())
+  {
+    _nextGraph.build(_nextWalls);
+  }
+  _nextExitLoc = exitLoc;
+  _nextMazeValid = exitLoc != NullLocation;
+  _random.setState(randomState);
+  swapInNextMaze();
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::prepareNextMaze()
+{
+  uint8_t requested = NextMazeRequested;
+  if (!_nextMazeState.compare_exchange_strong(requested, NextMazeBuilding, memory_order_acquire))
+  {
+    return false;
+  }
+
+  _nextMazeValid = buildNextMaze();
+  _nextMazeState.store(NextMazeReady, memory_order_release);
+  return true;
+}
+
+template <int Width, int Height, typename Renderer>
+uint32_t MazeRunnerEngine<Width, Height, Renderer>::ticksUntilChange() const
+{
+  // the last tick of the delay swaps in the next maze, or waits for it
+  if (_resetDelay > 0)
+  {
+    return _resetDelay - 1;
+  }
+  if (_exitLoc == NullLocation)
+  {
+    return NoPendingChange;
+  }
+
+  // agents off cooldown may search, and searches draw random numbers, even if they don't move
+  uint32_t ticks = NoPendingChange;
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
+  {
+    if (agent < _runnerCount && _agentLocs[agent] == NullLocation)
+    {
+      continue;
+    }
+    ticks = min(ticks, (uint32_t)_agentCooldowns[agent]);
+  }
+  return ticks;
+}
+
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::skipTicks(uint32_t ticks)
+{
+  if (ticks == 0)
+  {
+    return;
+  }
+  if (_recorder)
+  {
+    _recorder->tick(ticks);
+  }
+  if (_resetDelay > 0)
+  {
+    _resetDelay -= ticks;
+    return;
+  }
+  if (_exitLoc == NullLocation)
+  {
+    return;
+  }
+
+  _gameTicks += ticks;
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
+  {
+    if (agent < _runnerCount && _agentLocs[agent] == NullLocation)
+    {
+      continue;
+    }
+    _agentCooldowns[agent] -= ticks;
+  }
 }
 
-bool MazeRunner::update()
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::update()
 {
+  if (_recorder)
+  {
+    _recorder->tick();
+  }
+
   // pause before reset to show goal, catch, or error
   if (_resetDelay > 0)
   {
-    _resetDelay--;
-    if (_resetDelay <= 0)
+    if (_resetDelay > 1)
     {
-      init();
-      drawMaze();
-      return true;
+      _resetDelay--;
+      return false;
+    }
+
+    // build the next maze here if no one else has started it, wait if it's still being built
+    prepareNextMaze();
+    if (_nextMazeState.load(memory_order_acquire) != NextMazeReady)
+    {
+      return false;
     }
+
+    _resetDelay = 0;
+    swapInNextMaze();
+    drawMaze();
+    return true;
+  }
+
+  // no game to play before init() or after a failed build
+  if (_exitLoc == NullLocation)
+  {
     return false;
   }
 
   bool update = false;
+  _gameTicks++;
+
+  // the first runner onto the exit wins
+  for (int agent = 0; agent < _runnerCount; agent++)
+  {
+    update |= moveRunner(agent);
+  }
+  if (_runnerCounts[toIndex(_exitLoc)] > 0)
+  {
+    log_d("Runner reached exit");
+    _renderer.setStatus(_runnerColor);
+    drawMaze(); // redraw runner on goal
+    finishGame(GameOutcome::ReachedExit, _exitLoc, GoalDelay);
+    return true;
+  }
 
-  try
+  for (int agent = _runnerCount; agent < _runnerCount + _sentryCount; agent++)
   {
-    update |= moveRunner();
-    if (_runnerLoc == _exitLoc)
+    update |= moveSentry(agent);
+  }
+
+  // runners sharing a cell with a sentry are out, the game is lost when none are left
+  for (int agent = 0; agent < _runnerCount; agent++)
+  {
+    Location runnerLoc = _agentLocs[agent];
+    if (runnerLoc == NullLocation || _sentryCounts[toIndex(runnerLoc)] == 0)
     {
-      log_d("Runner reached exit");
-      _setStatus(_runnerColor);
-      drawMaze(); // redraw runner on goal
-      _resetDelay = GoalDelay;
-      return true;
+      continue;
     }
 
-    update |= moveSentry();
-    if (_sentryLoc == _runnerLoc)
+    log_d("Runner caught by sentry");
+    removeRunner(agent);
+    if (_runnersLeft == 0)
     {
-      log_d("Runner caught by sentry");
       // don't redraw sentry on runner
-      _setStatus(_sentryColor);
-      _resetDelay = CatchDelay;
+      _renderer.setStatus(_sentryColor);
+      finishGame(GameOutcome::Caught, runnerLoc, CatchDelay);
       return true;
     }
+    update = true;
+  }
 
-    if (update)
-    {
-      drawMaze();
-    }
-
-    return update;
+  if (update)
+  {
+    drawMaze();
   }
-  catch (const std::exception &e)
+
+  return update;
+}
+
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::finishGame(GameOutcome outcome, Location endLoc, int resetDelay)
+{
+  _lastOutcome = outcome;
+  _lastGameTicks = _gameTicks;
+  _gamesFinished++;
+  _startLoc = endLoc;
+  _resetDelay = resetDelay;
+  if (_recorder)
   {
-    log_e("Error in maze runner update: %s", e.what());
-    _setStatus(_exitColor);
-    _resetDelay = ErrorDelay;
-    return false;
+    _recorder->outcome(outcome, _gameTicks);
   }
+  _nextMazeState.store(NextMazeRequested, memory_order_release);
 }
 
-bool MazeRunner::moveRunner()
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::moveRunner(int agent)
 {
-  if (_runnerCooldown > 0)
+  MAZE_PROFILE_SCOPE(_profiler, MoveRunner);
+
+  Location runnerLoc = _agentLocs[agent];
+  Path &runnerPath = _agentPaths[agent];
+  Location &avoidLoc = _agentAvoidLocs[agent];
+  if (runnerLoc == NullLocation)
   {
-    _runnerCooldown--;
     return false;
   }
 
-  // sense and flee if sentry is near
-  deque<Location> sensedPathToSentry = findPathDfs(_runnerLoc, _sentryLoc, RunnerSense);
-  if (sensedPathToSentry.size() > 0)
+  if (_agentCooldowns[agent] > 0)
   {
-    _runnerSentryKnownLoc = _sentryLoc;
-    _runnerPath = findLongestPathBfs(_runnerLoc, _sentryLoc, RunnerSense + RunnerFear);
-    while (_runnerPath.size() > RunnerSense)
-    {
-      _runnerPath.pop_back();
-    }
+    _agentCooldowns[agent]--;
+    return false;
+  }
+
+  // sense and flee if a sentry is near
+  int sentryIndex = senseNearestAgent(runnerLoc, _runnerCount, _runnerCount + _sentryCount, _sentryCounts, _config.runnerSense);
+  if (sentryIndex >= 0)
+  {
+    Location sentryLoc = toLocation(sentryIndex);
+    avoidLoc = sentryLoc;
+    runnerPath.clear();
+    findLongestPathBfs(runnerLoc, sentryLoc, _config.runnerSense + _config.runnerFear, &runnerPath);
+    runnerPath.truncate(_config.runnerSense);
   }
   // plan if able
-  else if (_runnerPath.size() == 0)
+  else if (runnerPath.size() == 0)
   {
-    _runnerPath = findPathDfs(_runnerLoc, _runnerSentryKnownLoc, _exitLoc);
-    _runnerSentryKnownLoc = NullLocation;
-    _runnerPath = findPathDfs(_runnerLoc, _runnerSentryKnownLoc, _exitLoc);
+    // a random DFS path rather than a shortest one, so the runner can try the other way around a loop
+    findPathDfs(runnerLoc, avoidLoc, _exitLoc, -1, &runnerPath);
+    avoidLoc = NullLocation;
+    runnerPath.clear();
+    findPathDfs(runnerLoc, avoidLoc, _exitLoc, -1, &runnerPath);
   }
 
   // move
-  if (_runnerPath.size() > 0)
+  if (runnerPath.size() > 0)
   {
-    Location prevRunnerLoc = _runnerLoc;
-    _runnerLoc = _runnerPath.front();
-    _runnerPath.pop_front();
-    _runnerCooldown = RunnerSpeed;
-    log_v("Moved runner from (%d,%d) to (%d,%d)", prevRunnerLoc.x, prevRunnerLoc.y, _runnerLoc.x, _runnerLoc.y);
+    Location nextLoc = toLocation(runnerPath.front());
+    runnerPath.pop_front();
+    moveAgent(agent, nextLoc, _runnerCounts);
+    if (_runnerFlows[agent].isValid())
+    {
+      _runnerFlows[agent].moveSource(_mazeWalls, toIndex(nextLoc), _searchCells.data());
+    }
+    _agentCooldowns[agent] = _config.runnerSpeed;
+    log_v("Moved runner %d from (%d,%d) to (%d,%d)", agent, runnerLoc.x, runnerLoc.y, nextLoc.x, nextLoc.y);
     return true;
   }
 
   return false;
 }
 
-bool MazeRunner::moveSentry()
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::moveSentry(int agent)
 {
-  if (_sentryColor == _pathColor)
+  MAZE_PROFILE_SCOPE(_profiler, MoveSentry);
+
+  Location sentryLoc = _agentLocs[agent];
+  Path &sentryPath = _agentPaths[agent];
+  if (_agentCooldowns[agent] > 0)
   {
+    _agentCooldowns[agent]--;
     return false;
   }
 
-  if (_sentryCooldown > 0)
+  if (_config.sentryFlowField)
   {
-    _sentryCooldown--;
-    return false;
+    return moveSentryAlongFlow(agent);
   }
 
-  // sense runner
-  deque<Location> sensedPathToRunner = findPathDfs(_sentryLoc, _runnerLoc, SentrySense);
-  if (sensedPathToRunner.size() > 0)
+  // sense the nearest runner
+  int runnerIndex = senseNearestAgent(sentryLoc, 0, _runnerCount, _runnerCounts, _config.sentrySense);
+  if (runnerIndex >= 0 && findPathToward(sentryLoc, toLocation(runnerIndex), _config.sentrySense, &sentryPath))
   {
-    _sentryPath = sensedPathToRunner;
-
     // new detection, small "warm up" cooldown before moving
-    if (_sentryPath.size() == 0) // path implies runner was seen recently
+    if (sentryPath.size() == 0) // path implies runner was seen recently
     {
-      log_v("Sentry sensed runner at (%d,%d)", _runnerLoc.x, _runnerLoc.y);
-      _sentryCooldown = SentrySpeed / 2;
+      log_v("Sentry %d sensed runner at (%d,%d)", agent, toLocation(runnerIndex).x, toLocation(runnerIndex).y);
+      _agentCooldowns[agent] = _config.sentrySpeed / 2;
       return false;
     }
   }
@@ -298,7 +667,7 @@ bool MazeRunner::moveSentry()
   // // sense exit if not known
   // if (_sentryExitKnownLoc == NoLocation})
   // {
-  //   deque<Location> sensedPathToExit = findPathDfs(_sentryLoc, _exitLoc, SentrySense);
+  //   deque<Location> sensedPathToExit = findPathDfs(_sentryLoc, _exitLoc, _config.sentrySense);
   //   if (sensedPathToExit.size() > 0)
   //   {
   //     _sentryExitKnownLoc = _exitLoc;
@@ -313,240 +682,577 @@ bool MazeRunner::moveSentry()
   // }
 
   // move
-  if (_sentryPath.size() > 0)
+  if (sentryPath.size() > 0)
   {
-    Location prevSentryLoc = _sentryLoc;
-    _sentryLoc = _sentryPath.front();
-    _sentryPath.pop_front();
-    _sentryCooldown = SentrySpeed;
-    log_v("Moved sentry from (%d,%d) to (%d,%d)", prevSentryLoc.x, prevSentryLoc.y, _sentryLoc.x, _sentryLoc.y);
+    Location nextLoc = toLocation(sentryPath.front());
+    sentryPath.pop_front();
+    moveAgent(agent, nextLoc, _sentryCounts);
+    _agentCooldowns[agent] = _config.sentrySpeed;
+    log_v("Moved sentry %d from (%d,%d) to (%d,%d)", agent, sentryLoc.x, sentryLoc.y, nextLoc.x, nextLoc.y);
     return true;
   }
 
   return false;
 }
 
-void MazeRunner::drawMaze()
+// Senses and chases through the runners' flow fields instead of searching, following the nearest
+// runner for as many steps as it was away when last sensed. Unlike a planned path this tracks the
+// runner as it moves. Fields are built on first use and repaired by moveRunner().
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::moveSentryAlongFlow(int agent)
 {
-  for (int y = 0; y < _height; y++)
+  Location sentryLoc = _agentLocs[agent];
+  int sentryIndex = toIndex(sentryLoc);
+
+  // sense the nearest runner, every runner's field already holds its distance from here
+  int sensedTarget = -1;
+  int sensedDist = _config.sentrySense + 1;
+  for (int runner = 0; runner < _runnerCount; runner++)
   {
-    for (int x = 0; x < _width; x++)
+    if (_agentLocs[runner] == NullLocation)
     {
-      _drawPixel(x, y, _mazeWalls[y][x] ? _wallColor : _pathColor);
+      continue;
     }
-  }
-
-  _drawPixel(_exitLoc.x, _exitLoc.y, _exitColor);
-  _drawPixel(_runnerLoc.x, _runnerLoc.y, _runnerColor);
-  _drawPixel(_sentryLoc.x, _sentryLoc.y, _sentryColor);
-}
 
-void MazeRunner::generateMaze()
-{
-  log_d("Starting maze generation");
+    Flow &flow = _runnerFlows[runner];
+    if (!flow.isValid())
+    {
+      flow.build(_mazeWalls, toIndex(_agentLocs[runner]), _searchCells.data());
+    }
+    int dist = flow.distance(sentryIndex);
+    if (dist >= 0 && dist < sensedDist)
+    {
+      sensedTarget = runner;
+      sensedDist = dist;
+    }
+  }
 
-  // fill maze with walls (true)
-  for (int y = 0; y < _height; y++)
+  if (sensedTarget >= 0)
   {
-    for (int x = 0; x < _width; x++)
+    _agentTargets[agent] = sensedTarget;
+    _agentChaseSteps[agent] = sensedDist;
+    if (sensedDist == 0)
     {
-      _mazeWalls[y][x] = true;
+      log_v("Sentry %d sensed runner %d", agent, sensedTarget);
+      _agentCooldowns[agent] = _config.sentrySpeed / 2;
+      return false;
     }
   }
 
-  // define starting point randomly if runner loc is not defined
-  Location start = NullLocation;
-  if (_exitLoc == NullLocation)
+  // move
+  int target = _agentTargets[agent];
+  if (target < 0 || _agentChaseSteps[agent] == 0 || _agentLocs[target] == NullLocation)
   {
-    int edge = random(4);
-    int x = random(0, _width);
-    int y = random(_height);
-    start = {x, y};
+    return false;
   }
-  else
+
+  uint8_t direction = _runnerFlows[target].direction(sentryIndex);
+  if (direction == Flow::NoDirection)
   {
-    start = _runnerLoc;
+    return false;
   }
-  _mazeWalls[start.y][start.x] = false;
 
-  // create traversal stack with starting point
-  stack<Location> path = stack<Location>();
-  path.push(start);
-  int maxCycles = 1000;
+  Location nextLoc = {sentryLoc.x + Directions[direction].x, sentryLoc.y + Directions[direction].y};
+  moveAgent(agent, nextLoc, _sentryCounts);
+  _agentChaseSteps[agent]--;
+  _agentCooldowns[agent] = _config.sentrySpeed;
+  log_v("Moved sentry %d from (%d,%d) to (%d,%d)", agent, sentryLoc.x, sentryLoc.y, nextLoc.x, nextLoc.y);
+  return true;
+}
+
+// moves an agent to loc, keeping the occupancy counts and dirty cells up to date
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::moveAgent(int agent, Location loc, MazeBuffer<uint16_t, CellCount> &counts)
+{
+  Location prevLoc = _agentLocs[agent];
+  if (_recorder)
+  {
+    _recorder->move(agent, prevLoc, loc, width());
+  }
+  counts[toIndex(prevLoc)]--;
+  counts[toIndex(loc)]++;
+  _agentLocs[agent] = loc;
+  markDirty(prevLoc);
+  markDirty(loc);
+}
 
-  while (!path.empty() && maxCycles-- > 0)
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::removeRunner(int agent)
+{
+  Location runnerLoc = _agentLocs[agent];
+  if (_recorder)
   {
-    Location cur = path.top();
+    _recorder->remove(agent);
+  }
+  _runnerCounts[toIndex(runnerLoc)]--;
+  _agentLocs[agent] = NullLocation;
+  _agentPaths[agent].clear();
+  _runnerFlows[agent].clear();
+  _runnersLeft--;
+  markDirty(runnerLoc);
+}
+
+// Draws only the cells in view marked dirty since the last call, or every cell in view after init()
+// or when the camera moves. Either way the cost is bounded by the view, not the maze.
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::drawMaze()
+{
+  MAZE_PROFILE_SCOPE(_profiler, DrawMaze);
 
-    // shuffle directions randomly
-    Direction randSteps[4] = {Left, Right, Up, Down};
-    shuffleDirections(randSteps, 4);
+  for (int agent = 0; agent < _runnerCount; agent++)
+  {
+    if (_agentLocs[agent] != NullLocation)
+    {
+      _fullRedraw |= _camera.follow(_agentLocs[agent]);
+      break;
+    }
+  }
 
-    // try to move in each direction, pop location if no path forward
-    bool foundPath = false;
-    for (int i = 0; i < 4; i++)
+  if (!_fullRedraw)
+  {
+    for (int i = 0; i < _dirtyCount; i++)
     {
-      Location nextLoc = {cur.x + randSteps[i].x, cur.y + randSteps[i].y};
-      if (isInMazeBounds(nextLoc) && isWall(nextLoc) && getAdjacentWallAndBorderCount(nextLoc) >= 3)
+      Location loc = toLocation(_dirtyIndexes[i]);
+      _dirtyCells.set(loc.x, loc.y, false);
+      if (_camera.contains(loc))
       {
-        _mazeWalls[nextLoc.y][nextLoc.x] = false;
-        path.push(nextLoc);
-        foundPath = true;
-        break;
+        drawCell(loc.x, loc.y);
       }
     }
+    _dirtyCount = 0;
+    return;
+  }
 
-    if (!foundPath)
+  int left = _camera.x();
+  int top = _camera.y();
+  for (int y = 0; y < _camera.viewHeight(); y++)
+  {
+    const uint32_t *row = _mazeWalls.row(top + y);
+    for (int x = 0; x < _camera.viewWidth(); x++)
     {
-      path.pop();
+      int mazeX = left + x;
+      _renderer.drawPixel(x, y, (row[mazeX / Grid::WordBits] >> (mazeX % Grid::WordBits)) & 1 ? _wallColor : _pathColor);
     }
   }
 
-  int wallsRemoved = 0;
-  maxCycles = 1000;
-  while (wallsRemoved < _mazeExtraWallsToRemove && maxCycles-- > 0)
+  if (_camera.contains(_exitLoc))
+  {
+    _renderer.drawPixel(_exitLoc.x - left, _exitLoc.y - top, _exitColor);
+  }
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
   {
-    int x = random(_width);
-    int y = random(_height);
-    if (isWall(x, y) && getAdjacentWallAndBorderCount(x, y) >= 2)
+    Location loc = _agentLocs[agent];
+    if (_camera.contains(loc))
     {
-      _mazeWalls[y][x] = false;
-      wallsRemoved++;
+      _renderer.drawPixel(loc.x - left, loc.y - top, agent < _runnerCount ? _runnerColor : _sentryColor);
     }
   }
 
-  if (maxCycles <= 0)
+  for (int i = 0; i < _dirtyCount; i++)
   {
-    log_e("Failed to remove extra walls");
+    Location loc = toLocation(_dirtyIndexes[i]);
+    _dirtyCells.set(loc.x, loc.y, false);
   }
+  _dirtyCount = 0;
+  _fullRedraw = false;
+}
 
-  log_d("Maze generation complete");
+// same layering as a full redraw: sentry over runner over exit over the maze
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::drawCell(int x, int y)
+{
+  Location loc = {x, y};
+  uint32_t color = isWall(x, y) ? _wallColor : _pathColor;
+  color = loc == _exitLoc ? _exitColor : color;
+  color = _runnerCounts[toIndex(loc)] > 0 ? _runnerColor : color;
+  color = _sentryCounts[toIndex(loc)] > 0 ? _sentryColor : color;
+  _renderer.drawPixel(x - _camera.x(), y - _camera.y(), color);
 }
 
-void MazeRunner::placeRunner()
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::markDirty(Location loc)
 {
-  _runnerPath = {};
-  _runnerSentryKnownLoc = NullLocation;
-  _runnerCooldown = 0;
+  if (isInMazeBounds(loc) && !_dirtyCells.get(loc.x, loc.y))
+  {
+    _dirtyCells.set(loc.x, loc.y, true);
+    _dirtyIndexes[_dirtyCount++] = toIndex(loc);
+  }
+}
+
+// everything here only writes the next buffers, the current game stays intact until swapInNextMaze()
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::buildNextMaze()
+{
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
+  {
+    _nextAgentLocs[agent] = NullLocation;
+  }
+  _nextExitLoc = NullLocation;
+
+  generateMaze();
+  return placeRunners() && placeSentries() && placeExit();
+}
 
-  if (_runnerLoc.x > 0 && _runnerLoc.y > 0)
+// starts the built game, O(agents) apart from the wall swap, which is O(1) for runtime sized mazes
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::swapInNextMaze()
+{
+  // the occupancy grids only count agents, so clearing their cells clears the grids
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
   {
-    if (_runnerLoc == _exitLoc)
+    Location loc = _agentLocs[agent];
+    if (loc != NullLocation)
     {
-      log_d("Runner stays at prev exit loc at (%d,%d)", _runnerLoc.x, _runnerLoc.y);
-      return;
+      (agent < _runnerCount ? _runnerCounts : _sentryCounts)[toIndex(loc)] = 0;
     }
-    else if (_runnerLoc == _sentryLoc)
+  }
+
+  _mazeWalls.swap(_nextWalls);
+  _mazeGraph.swap(_nextGraph);
+  _agentLocs.swap(_nextAgentLocs);
+  _exitLoc = _nextMazeValid ? _nextExitLoc : NullLocation;
+  _distanceFields.clear();
+#if MAZE_PROFILING
+  // the build is finished and nothing starts another until this task requests it
+  _profiler.merge(_prepareProfiler);
+  _prepareProfiler.reset();
+#endif
+  _nextMazeState.store(NextMazeIdle, memory_order_relaxed);
+
+  for (int agent = 0; agent < _runnerCount + _sentryCount; agent++)
+  {
+    bool runner = agent < _runnerCount;
+    if (_agentLocs[agent] != NullLocation)
     {
-      log_d("Runner stays at prev sentry loc at (%d,%d)", _runnerLoc.x, _runnerLoc.y);
-      return;
+      (runner ? _runnerCounts : _sentryCounts)[toIndex(_agentLocs[agent])]++;
     }
-    else
+    _agentPaths[agent].clear();
+    _agentAvoidLocs[agent] = NullLocation;
+    _agentCooldowns[agent] = runner ? 0 : _config.sentrySpeed;
+    _agentTargets[agent] = -1;
+    _agentChaseSteps[agent] = 0;
+    if (runner)
     {
-      log_e("Runner unexpectedly not at exit or sentry loc: (%d,%d)", _runnerLoc.x, _runnerLoc.y);
+      _runnerFlows[agent].clear();
     }
   }
-
-  int attempts = 0;
-  while (_runnerLoc.x < 0 || _runnerLoc.y < 0)
+  _runnersLeft = _runnerCount;
+  _gameTicks = 0;
+  _fullRedraw = true;
+  if (_agentLocs[0] != NullLocation)
   {
-    int x = random(_width);
-    int y = random(_height);
-    if (!isWall(x, y))
-    {
-      _runnerLoc = {x, y};
-    }
-    attempts++;
+    _camera.center(_agentLocs[0]);
   }
-  log_d("Placing runner at (%d,%d) after %d attempts", _runnerLoc.x, _runnerLoc.y, attempts);
-}
 
-void MazeRunner::placeSentry()
-{
-  if (_sentryColor == _pathColor)
+  if (_recorder)
   {
-    return;
+    uint32_t randomState[4];
+    _random.getState(randomState);
+    _recorder->maze(_mazeWalls, width(), height(), _runnerCount, _sentryCount, _config, randomState, _exitLoc, _agentLocs.data());
   }
 
-  _sentryLoc = NullLocation;
-  _sentryPath = {};
-  _sentryCooldown = SentrySpeed;
-
-  int attempts = 0;
-  while (_sentryLoc.x == -1)
+#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_VERBOSE
+  log_v("*--------*");
+  for (int y = 0; y < height(); y++)
   {
-    int x = random(_width);
-    int y = random(_height);
-    int distance = abs(x - _runnerLoc.x) + abs(y - _runnerLoc.y);
-    int minDistance = max(0, (_width + _height) / 2 - (attempts / 10));
-    if (!isWall(x, y) && distance > minDistance)
+    String row = "|";
+    for (int x = 0; x < width(); x++)
     {
-      _sentryLoc = {x, y};
+      char c = isWall(x, y) ? '#' : ' ';
+      c = _runnerCounts[toIndex({x, y})] > 0 ? 'S' : c;
+      c = _sentryCounts[toIndex({x, y})] > 0 ? 'X' : c;
+      c = (_exitLoc.x == x && _exitLoc.y == y) ? 'E' : c;
+      row += c;
     }
-    attempts++;
+    row += "|";
+    log_v("%s", row.c_str());
+  }
+  log_v("*--------*");
+#endif
+
+  if (!_nextMazeValid)
+  {
+    _renderer.setStatus(_exitColor);
+    finishGame(GameOutcome::Error, NullLocation, ErrorDelay);
   }
-  log_d("Placing sentry at (%d,%d) after %d attempts", _sentryLoc.x, _sentryLoc.y, attempts);
 }
 
-void MazeRunner::placeExit()
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::generateMaze()
 {
-  _exitLoc = NullLocation;
+  MAZE_PROFILE_SCOPE(_prepareProfiler, GenerateMaze);
+  log_d("Starting maze generation");
 
-  deque<Location> path = findLongestPathBfs(_runnerLoc);
-  if (path.size() == 0)
+  // fill maze with walls (true)
+  _nextWalls.fill(true);
+
+  // grow the maze from where the last game ended, or from a random point
+  Location start = NullLocation;
+  if (_startLoc == NullLocation)
   {
-    log_e("Failed to find path to exit");
-    _setStatus(_exitColor);
-    _resetDelay = ErrorDelay;
-    return;
+    (void)_random.uniform(4); // keeps the RNG stream unchanged
+    int x = _random.uniform(0, width());
+    int y = _random.uniform(height());
+    start = {x, y};
+  }
+  else
+  {
+    start = _startLoc;
+  }
+  // no searches run while a maze is built, so their queue is free to use as scratch
+  int *scratch = _searchCells.data();
+  switch (_config.mazeGenerator)
+  {
+  case MazeGenerator::GrowingTree:
+    GrowingTreeGenerator::generate(_nextWalls, start, _random, scratch);
+    break;
+  case MazeGenerator::Wilson:
+    WilsonGenerator::generate(_nextWalls, start, _random, scratch);
+    break;
+  case MazeGenerator::Eller:
+    EllerRowStream::generate(_nextWalls, start, _random, scratch);
+    break;
+  case MazeGenerator::Chunked:
+    ChunkedGenerator::generate(_nextWalls, start, _random, scratch);
+    break;
+  default:
+    CarvedDfsGenerator::generate(_nextWalls, start, _random, scratch);
+    break;
   }
 
-  _exitLoc = path.back();
+  removeExtraWalls();
+  if (useGraphSearch() && !_nextGraph.build(_nextWalls))
+  {
+    log_w("Maze too open for a corridor graph, searching cell by cell");
+  }
 
-  log_d("Placing exit at (%d,%d) with distance %d from runner", _exitLoc.x, _exitLoc.y, path.size());
+  log_d("Maze generation complete");
 }
 
-deque<Location> MazeRunner::findPathDfs(Location startLoc, Location sentryLoc, Location endLoc, int maxSearchDistance)
+// opens a few walls to make loops, picked at random among the walls with at least two wall or border neighbors
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::removeExtraWalls()
 {
-  stack<pair<Location, int>> locsToVisit = stack<pair<Location, int>>();
-  unordered_set<Location> locsVisited = unordered_set<Location>();
-  stack<Location> curPath = stack<Location>();
-
-  locsToVisit.push({startLoc, 0});
-
-  while (!locsToVisit.empty())
+  int candidateCount = 0;
+  for (int y = 0; y < height(); y++)
   {
-    pair<Location, int> curLocAndDist = locsToVisit.top();
-    Location curLoc = curLocAndDist.first;
-    int distFromStart = curLocAndDist.second;
-    locsToVisit.pop();
+    for (int x = 0; x < width(); x++)
+    {
+      if (_nextWalls.get(x, y) && _nextWalls.getAdjacentSetOrBorderCount(x, y) >= 2)
+      {
+        _searchCells[candidateCount++] = toIndex({x, y});
+      }
+    }
+  }
+
+  // opening a wall can disqualify its neighbors, so each pick is checked again
+  int wallsRemoved = 0;
+  while (wallsRemoved < _mazeExtraWallsToRemove && candidateCount > 0)
+  {
+    int pick = _random.uniform(candidateCount);
+    Location loc = toLocation(_searchCells[pick]);
+    _searchCells[pick] = _searchCells[--candidateCount];
+    if (_nextWalls.getAdjacentSetOrBorderCount(loc.x, loc.y) >= 2)
+    {
+      _nextWalls.set(loc.x, loc.y, false);
+      wallsRemoved++;
+    }
+  }
+
+  if (wallsRemoved < _mazeExtraWallsToRemove)
+  {
+    log_w("Only %d of %d extra walls could be removed", wallsRemoved, _mazeExtraWallsToRemove);
+  }
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::placeRunners()
+{
+  for (int agent = 0; agent < _runnerCount; agent++)
+  {
+    // the first runner stays where the last game ended, on the exit or where it was caught
+    Location runnerLoc = agent == 0 ? _startLoc : NullLocation;
+    if (runnerLoc != NullLocation)
+    {
+      log_d("Runner stays at prev end loc at (%d,%d)", runnerLoc.x, runnerLoc.y);
+    }
+
+    int attempts = 0;
+    while (runnerLoc == NullLocation && attempts < MaxPlacementAttempts)
+    {
+      int x = _random.uniform(width());
+      int y = _random.uniform(height());
+      if (!_nextWalls.get(x, y))
+      {
+        runnerLoc = {x, y};
+      }
+      attempts++;
+    }
+    if (runnerLoc == NullLocation)
+    {
+      runnerLoc = findOpenCell(NullLocation);
+    }
+    if (runnerLoc == NullLocation)
+    {
+      log_e("Failed to place runner %d", agent);
+      return false;
+    }
+    log_d("Placing runner %d at (%d,%d) after %d attempts", agent, runnerLoc.x, runnerLoc.y, attempts);
+
+    _nextAgentLocs[agent] = runnerLoc;
+  }
+  return true;
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::placeSentries()
+{
+  for (int agent = _runnerCount; agent < _runnerCount + _sentryCount; agent++)
+  {
+    // far from every runner, relaxing the distance as attempts fail
+    Location sentryLoc = NullLocation;
+    int attempts = 0;
+    int maxAttempts = 10 * ((width() + height()) / 2) + MaxPlacementAttempts; // the distance is down to 0 after the first term
+    while (sentryLoc == NullLocation && attempts < maxAttempts)
+    {
+      int x = _random.uniform(width());
+      int y = _random.uniform(height());
+      int distance = width() + height();
+      for (int runner = 0; runner < _runnerCount; runner++)
+      {
+        distance = min(distance, abs(x - _nextAgentLocs[runner].x) + abs(y - _nextAgentLocs[runner].y));
+      }
+      int minDistance = max(0, (width() + height()) / 2 - (attempts / 10));
+      if (!_nextWalls.get(x, y) && distance > minDistance)
+      {
+        sentryLoc = {x, y};
+      }
+      attempts++;
+    }
+    // never on the first runner, that would be an instant catch
+    if (sentryLoc == NullLocation)
+    {
+      sentryLoc = findOpenCell(_nextAgentLocs[0]);
+    }
+    if (sentryLoc == NullLocation)
+    {
+      log_e("Failed to place sentry %d", agent);
+      return false;
+    }
+    log_d("Placing sentry %d at (%d,%d) after %d attempts", agent, sentryLoc.x, sentryLoc.y, attempts);
+
+    _nextAgentLocs[agent] = sentryLoc;
+  }
+  return true;
+}
 
-    // if curPath size is greater than distance than we need to unwind path to current distance
-    while (curPath.size() > distFromStart)
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::placeExit()
+{
+  int exitDist = 0;
+  int exitIndex;
+  if (_nextGraph.isValid())
+  {
+    exitIndex = _nextGraph.findFarthestCell(toIndex(_nextAgentLocs[0]), _searchCells.data(), _searchDists.data(), _parentIndexes.data(), &exitDist);
+    MAZE_PROFILE_NODES(_prepareProfiler, _nextGraph.lastSearchNodes());
+  }
+  else if (useBitboardSearch())
+  {
+    Location exitLoc = NullLocation;
+    findPathBitboard(_nextWalls, _nextAgentLocs[0], NullLocation, NullLocation, -1, nullptr, &exitLoc);
+    exitIndex = exitLoc != NullLocation ? toIndex(exitLoc) : -1;
+    exitDist = exitIndex >= 0 ? _searchDists[exitIndex] : 0;
+  }
+  else
+  {
+    exitIndex = findFarthestCell(_nextWalls, _nextAgentLocs[0], &exitDist);
+  }
+  _nextExitLoc = exitIndex >= 0 ? toLocation(exitIndex) : NullLocation;
+
+  if (_nextExitLoc == NullLocation)
+  {
+    log_e("Failed to find path to exit");
+    return false;
+  }
+
+  log_d("Placing exit at (%d,%d) with distance %d from runner", _nextExitLoc.x, _nextExitLoc.y, exitDist);
+  return true;
+}
+
+// first open cell of the next maze in row order other than avoidLoc, for when random picks keep missing
+template <int Width, int Height, typename Renderer>
+Location MazeRunnerEngine<Width, Height, Renderer>::findOpenCell(Location avoidLoc)
+{
+  for (int y = 0; y < height(); y++)
+  {
+    for (int x = 0; x < width(); x++)
+    {
+      if (!_nextWalls.get(x, y) && Location{x, y} != avoidLoc)
+      {
+        return {x, y};
+      }
+    }
+  }
+  return NullLocation;
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::findPathDfs(Location startLoc, Location sentryLoc, Location endLoc, int maxSearchDistance, Path *path)
+{
+  MAZE_PROFILE_SCOPE(_profiler, FindPathDfs);
+
+  // bounded sense searches on large mazes expand a few whole frontiers instead
+  if (maxSearchDistance > 0 && useBitboardSearch())
+  {
+    return findPathBitboard(_mazeWalls, startLoc, sentryLoc, endLoc, maxSearchDistance, path);
+  }
+  // and unbounded ones go from junction to junction
+  if (maxSearchDistance <= 0 && _mazeGraph.isValid())
+  {
+    return findPathGraph(startLoc, sentryLoc, endLoc, path);
+  }
+
+  beginSearch();
+
+  int stackSize = 0;
+  int pathSize = 0;
+  _searchCells[stackSize] = toIndex(startLoc);
+  _searchDists[stackSize++] = 0;
+
+  while (stackSize > 0)
+  {
+    stackSize--;
+    int curIndex = _searchCells[stackSize];
+    int distFromStart = _searchDists[stackSize];
+    if (isVisited(curIndex))
     {
-      curPath.pop();
+      continue;
     }
-    curPath.push(curLoc);
+    Location curLoc = toLocation(curIndex);
+
+    // if path is longer than distance then we need to unwind path to current distance
+    pathSize = distFromStart;
+    _searchPathCells[pathSize++] = curIndex;
 
-    // found end, return reverse path stack and return
+    // found end, write path without start location
     if (curLoc == endLoc)
     {
       log_v("Found path from (%d,%d) to (%d,%d)", startLoc.x, startLoc.y, curLoc.x, curLoc.y);
 
-      std::deque<Location> path;
-      while (!curPath.empty())
+      if (path != nullptr)
       {
-        path.push_front(curPath.top());
-        curPath.pop();
+        path->clear();
+        for (int i = 1; i < pathSize; i++)
+        {
+          path->push_back(_searchPathCells[i]);
+        }
       }
 
-      // remove start location from path
-      path.pop_front();
-
-      return path;
+      return true;
     }
 
-    locsVisited.insert(curLoc);
+    markVisited(curIndex);
+    MAZE_PROFILE_NODES(_profiler, 1);
 
     // don't visit locations further than maxDistToEnd
     if (maxSearchDistance > 0 && (distFromStart + 1) > maxSearchDistance)
@@ -555,40 +1261,76 @@ deque<Location> MazeRunner::findPathDfs(Location startLoc, Location sentryLoc, L
     }
 
     // look in different directions randomly in case of loops for variety of potential paths
-    Direction randSteps[4] = {Left, Right, Up, Down};
-    shuffleDirections(randSteps, 4);
+    const DirectionOrder &randSteps = randomDirectionOrder();
 
     for (Direction step : randSteps)
     {
       Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
-      if (isInMazeBounds(nextLoc) && !isWall(nextLoc) && (sentryLoc == NullLocation || (nextLoc != sentryLoc && !isAdjacent(nextLoc, sentryLoc))) && !locsVisited.count(nextLoc))
+      if (isInMazeBounds(nextLoc) && !isWall(nextLoc) && (sentryLoc == NullLocation || (nextLoc != sentryLoc && !isAdjacent(nextLoc, sentryLoc))) && !isVisited(toIndex(nextLoc)))
       {
-        locsToVisit.push({nextLoc, distFromStart + 1});
+        _searchCells[stackSize] = toIndex(nextLoc);
+        _searchDists[stackSize++] = distFromStart + 1;
       }
     }
   }
 
-  return deque<Location>();
+  return false;
 }
 
-deque<Location> MazeRunner::findLongestPathBfs(Location startLoc, Location sentryLoc, int maxSearchDistance)
+// findPathDfs() over the corridor graph, cells next to the sentry are off limits as before
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::findPathGraph(Location startLoc, Location sentryLoc, Location endLoc, Path *path)
 {
-  queue<pair<Location, int>> locsToVisit = queue<pair<Location, int>>();
-  unordered_set<Location> locsVisited = unordered_set<Location>();
-  unordered_map<Location, Location> visitedFrom = unordered_map<Location, Location>();
-  pair<Location, int> farthestLocAndDist = {startLoc, 0};
+  int blockedCells[1 + 4];
+  int blockedCount = 0;
+  if (sentryLoc != NullLocation)
+  {
+    blockedCells[blockedCount++] = toIndex(sentryLoc);
+    for (Direction step : Directions)
+    {
+      Location loc = {sentryLoc.x + step.x, sentryLoc.y + step.y};
+      if (isInMazeBounds(loc) && !isWall(loc))
+      {
+        blockedCells[blockedCount++] = toIndex(loc);
+      }
+    }
+  }
 
-  locsToVisit.push({startLoc, 0});
-  visitedFrom[startLoc] = startLoc; // special case start location, visited from itself
+  bool found = _mazeGraph.findPath(toIndex(startLoc), toIndex(endLoc), blockedCells, blockedCount, _random, _searchCells.data(),
+                                   _searchDists.data(), _searchPathCells.data(), path);
+  MAZE_PROFILE_NODES(_profiler, _mazeGraph.lastSearchNodes());
+  return found;
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::findLongestPathBfs(Location startLoc, Location sentryLoc, int maxSearchDistance, Path *path)
+{
+  MAZE_PROFILE_SCOPE(_profiler, FindLongestPathBfs);
 
-  while (!locsToVisit.empty())
+  if (useBitboardSearch())
   {
-    pair<Location, int> curLocAndDist = locsToVisit.front();
-    Location curLoc = curLocAndDist.first;
-    int distFromStart = curLocAndDist.second;
-    locsToVisit.pop();
+    return findPathBitboard(_mazeWalls, startLoc, sentryLoc, NullLocation, maxSearchDistance, path);
+  }
+
+  beginSearch();
+
+  int queueHead = 0;
+  int queueTail = 0;
+  int startIndex = toIndex(startLoc);
+  int farthestIndex = startIndex;
+  int farthestDist = 0;
 
-    locsVisited.insert(curLoc);
+  _searchCells[queueTail] = startIndex;
+  _searchDists[queueTail++] = 0;
+  _parentIndexes[startIndex] = startIndex; // special case start location, visited from itself
+  markVisited(startIndex);
+
+  while (queueHead < queueTail)
+  {
+    int curIndex = _searchCells[queueHead];
+    int distFromStart = _searchDists[queueHead++];
+    MAZE_PROFILE_NODES(_profiler, 1);
+    Location curLoc = toLocation(curIndex);
 
     // don't visit locations further than maxSearchDistance
     if (maxSearchDistance > 0 && (distFromStart + 1) > maxSearchDistance)
@@ -597,91 +1339,643 @@ deque<Location> MazeRunner::findLongestPathBfs(Location startLoc, Location sentr
     }
 
     // look in different directions randomly in case of loops for variety of potential paths
-    Direction randSteps[4] = {Left, Right, Up, Down};
-    shuffleDirections(randSteps, 4);
+    const DirectionOrder &randSteps = randomDirectionOrder();
 
     for (Direction step : randSteps)
     {
       Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
-      if (isInMazeBounds(nextLoc) && !isWall(nextLoc) && (sentryLoc == NullLocation || (nextLoc != sentryLoc && !isAdjacent(nextLoc, sentryLoc))) && !locsVisited.count(nextLoc))
+      if (!isInMazeBounds(nextLoc) || isWall(nextLoc) || (sentryLoc != NullLocation && (nextLoc == sentryLoc || isAdjacent(nextLoc, sentryLoc))))
+      {
+        continue;
+      }
+
+      int nextIndex = toIndex(nextLoc);
+      if (isVisited(nextIndex))
+      {
+        continue;
+      }
+
+      // cells are marked when queued, so each is queued at most once
+      markVisited(nextIndex);
+      _parentIndexes[nextIndex] = curIndex;
+      _searchCells[queueTail] = nextIndex;
+      _searchDists[queueTail++] = distFromStart + 1;
+
+      if (distFromStart + 1 > farthestDist)
+      {
+        farthestIndex = nextIndex;
+        farthestDist = distFromStart + 1;
+      }
+    }
+  }
+
+  // nowhere to go
+  if (farthestDist == 0)
+  {
+    return false;
+  }
+
+  // build path to farthest location, walking back from the end
+  if (path != nullptr)
+  {
+    path->clear();
+    for (int curIndex = farthestIndex; curIndex != startIndex; curIndex = _parentIndexes[curIndex])
+    {
+      path->push_front(curIndex);
+    }
+  }
+
+  return true;
+}
+
+// index of a cell farthest from startLoc in walls, which need not be the current maze, -1 if
+// startLoc is walled in. Visits neighbors in random order like findLongestPathBfs(), so ties go to
+// a random cell.
+template <int Width, int Height, typename Renderer>
+int MazeRunnerEngine<Width, Height, Renderer>::findFarthestCell(const Grid &walls, Location startLoc, int *farthestDist)
+{
+  beginSearch();
+
+  int queueHead = 0;
+  int queueTail = 0;
+  int startIndex = toIndex(startLoc);
+  int farthestIndex = startIndex;
+  *farthestDist = 0;
+
+  _searchCells[queueTail] = startIndex;
+  _searchDists[queueTail++] = 0;
+  markVisited(startIndex);
+
+  while (queueHead < queueTail)
+  {
+    int curIndex = _searchCells[queueHead];
+    int distFromStart = _searchDists[queueHead++];
+    MAZE_PROFILE_NODES(_prepareProfiler, 1);
+    Location curLoc = toLocation(curIndex);
+
+    const DirectionOrder &randSteps = randomDirectionOrder();
+    for (Direction step : randSteps)
+    {
+      Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
+      if (!isInMazeBounds(nextLoc) || walls.get(nextLoc.x, nextLoc.y) || isVisited(toIndex(nextLoc)))
+      {
+        continue;
+      }
+
+      int nextIndex = toIndex(nextLoc);
+      markVisited(nextIndex);
+      _searchCells[queueTail] = nextIndex;
+      _searchDists[queueTail++] = distFromStart + 1;
+
+      if (distFromStart + 1 > *farthestDist)
+      {
+        farthestIndex = nextIndex;
+        *farthestDist = distFromStart + 1;
+      }
+    }
+  }
+
+  return *farthestDist > 0 ? farthestIndex : -1;
+}
+
+// BFS that expands the whole frontier per distance layer with shifts and masks on row words,
+// finds a shortest path to endLoc, or a path to a random farthest cell if endLoc is NullLocation,
+// which also goes to farthestLoc. walls is the current maze, or the next one while it's built.
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::findPathBitboard(const Grid &walls, Location startLoc, Location sentryLoc, Location endLoc,
+                                                                 int maxSearchDistance, Path *path, Location *farthestLoc)
+{
+  if (startLoc == endLoc)
+  {
+    if (path != nullptr)
+    {
+      path->clear();
+    }
+    return true;
+  }
+
+  beginSearch();
+
+  const int wordsPerRow = walls.wordsPerRow();
+  const uint32_t lastWordMask = walls.wordMask(wordsPerRow - 1);
+  uint32_t *frontier = _searchFrontier.row(0);
+  uint32_t *next = _searchNext.row(0);
+  uint32_t *visited = _searchVisited.row(0);
+  const uint32_t *wallWords = walls.row(0);
+  const uint32_t *blocked = _searchBlocked.row(0);
+  int *frontierWords = _frontierWords.data();
+  int *nextWords = _nextWords.data();
+
+  int startWord = startLoc.y * wordsPerRow + startLoc.x / Grid::WordBits;
+  uint32_t startBit = 1u << (startLoc.x % Grid::WordBits);
+  frontier[startWord] = startBit;
+  visited[startWord] = startBit;
+  _visitedWordStamps[startWord] = _searchStamp;
+  _searchDists[toIndex(startLoc)] = 0;
+  int frontierCount = 0;
+  frontierWords[frontierCount++] = startWord;
+
+  // sentry cell and its 4-neighborhood as one mask, dilated from the sentry bit
+  int blockedLo = 0;
+  int blockedHi = -1;
+  if (sentryLoc != NullLocation)
+  {
+    blockedLo = max(0, sentryLoc.y - 1);
+    blockedHi = min(height() - 1, sentryLoc.y + 1);
+    _searchBlocked.set(sentryLoc.x, sentryLoc.y, true);
+    for (int y = blockedLo; y <= blockedHi; y++)
+    {
+      _searchBlocked.getDilatedRow(y, _searchNext.row(y));
+    }
+    for (int y = blockedLo; y <= blockedHi; y++)
+    {
+      memcpy(_searchBlocked.row(y), _searchNext.row(y), wordsPerRow * sizeof(uint32_t));
+    }
+  }
+
+  int dist = 0;
+  bool foundEnd = false;
+  int endWord = endLoc != NullLocation ? endLoc.y * wordsPerRow + endLoc.x / Grid::WordBits : -1;
+  while (maxSearchDistance <= 0 || dist < maxSearchDistance)
+  {
+    // only words holding or next to frontier bits can gain bits in the next layer
+    int candidateCount = 0;
+    for (int i = 0; i < frontierCount; i++)
+    {
+      int word = frontierWords[i];
+      int w = word % wordsPerRow;
+      int neighbors[5] = {
+          word,
+          (w > 0 && (frontier[word] & 1)) ? word - 1 : -1,
+          (w + 1 < wordsPerRow && (frontier[word] >> (Grid::WordBits - 1))) ? word + 1 : -1,
+          word >= wordsPerRow ? word - wordsPerRow : -1,
+          word + wordsPerRow < wordsPerRow * height() ? word + wordsPerRow : -1};
+      for (int neighbor : neighbors)
+      {
+        if (neighbor >= 0 && !_wordQueued[neighbor])
+        {
+          _wordQueued[neighbor] = true;
+          _candidateWords[candidateCount++] = neighbor;
+        }
+      }
+    }
+
+    // next layer is every open, unvisited, unblocked neighbor of the frontier
+    int nextCount = 0;
+    for (int i = 0; i < candidateCount; i++)
+    {
+      int word = _candidateWords[i];
+      int w = word % wordsPerRow;
+      _wordQueued[word] = false;
+
+      uint32_t cur = frontier[word];
+      uint32_t bits = cur | (cur << 1) | (cur >> 1);
+      if (w > 0)
+      {
+        bits |= frontier[word - 1] >> (Grid::WordBits - 1);
+      }
+      if (w + 1 < wordsPerRow)
+      {
+        bits |= frontier[word + 1] << (Grid::WordBits - 1);
+      }
+      else
       {
-        pair<Location, int> nextLocAndDist = {nextLoc, distFromStart + 1};
-        locsToVisit.push(nextLocAndDist);
-        visitedFrom[nextLoc] = curLoc;
+        bits &= lastWordMask;
+      }
+      if (word >= wordsPerRow)
+      {
+        bits |= frontier[word - wordsPerRow];
+      }
+      if (word + wordsPerRow < wordsPerRow * height())
+      {
+        bits |= frontier[word + wordsPerRow];
+      }
+
+      uint32_t visitedBits = _visitedWordStamps[word] == _searchStamp ? visited[word] : 0;
+      bits &= ~wallWords[word] & ~blocked[word] & ~visitedBits;
+      if (bits != 0)
+      {
+        next[word] = bits;
+        nextWords[nextCount++] = word;
+      }
+    }
+
+    if (nextCount == 0)
+    {
+      break;
+    }
 
-        if (nextLocAndDist.second > farthestLocAndDist.second)
+    dist++;
+    for (int i = 0; i < frontierCount; i++)
+    {
+      frontier[frontierWords[i]] = 0;
+    }
+    for (int i = 0; i < nextCount; i++)
+    {
+      int word = nextWords[i];
+      frontier[word] = next[word];
+      if (_visitedWordStamps[word] != _searchStamp)
+      {
+        _visitedWordStamps[word] = _searchStamp;
+        visited[word] = 0;
+      }
+      visited[word] |= next[word];
+
+      int firstCell = (word / wordsPerRow) * width() + (word % wordsPerRow) * Grid::WordBits;
+      MAZE_PROFILE_NODES(&walls == &_nextWalls ? _prepareProfiler : _profiler, __builtin_popcount(next[word]));
+      for (uint32_t bits = next[word]; bits != 0; bits &= bits - 1)
+      {
+        _searchDists[firstCell + __builtin_ctz(bits)] = dist; // indexed by cell here
+      }
+    }
+    swap(frontierWords, nextWords);
+    frontierCount = nextCount;
+
+    if (endWord >= 0 && (frontier[endWord] >> (endLoc.x % Grid::WordBits)) & 1)
+    {
+      foundEnd = true;
+      break;
+    }
+  }
+
+  for (int y = blockedLo; y <= blockedHi; y++)
+  {
+    _searchBlocked.clearRow(y);
+  }
+
+  // pick a random cell of the last layer as the farthest location
+  Location targetLoc = endLoc;
+  if (endLoc == NullLocation && dist > 0 && (path != nullptr || farthestLoc != nullptr))
+  {
+    int count = 0;
+    for (int i = 0; i < frontierCount; i++)
+    {
+      count += __builtin_popcount(frontier[frontierWords[i]]);
+    }
+
+    int pick = _random.uniform(count);
+    for (int i = 0; i < frontierCount && targetLoc == NullLocation; i++)
+    {
+      int word = frontierWords[i];
+      for (uint32_t bits = frontier[word]; bits != 0; bits &= bits - 1)
+      {
+        if (pick-- == 0)
         {
-          farthestLocAndDist = nextLocAndDist;
+          targetLoc = {(word % wordsPerRow) * Grid::WordBits + __builtin_ctz(bits), word / wordsPerRow};
+          break;
         }
       }
     }
   }
 
-  // nowhere to go
-  if (farthestLocAndDist.second == 0)
+  for (int i = 0; i < frontierCount; i++)
+  {
+    frontier[frontierWords[i]] = 0;
+  }
+
+  if (endLoc != NullLocation ? !foundEnd : dist == 0)
+  {
+    return false;
+  }
+  if (farthestLoc != nullptr)
+  {
+    *farthestLoc = targetLoc;
+  }
+
+  if (path == nullptr)
   {
-    return deque<Location>();
+    return true;
   }
 
-  // build path to farthest location
-  deque<Location> path = deque<Location>();
-  Location curLoc = farthestLocAndDist.first;
-  while (curLoc != startLoc)
+  // walk back through the distance layers
+  path->clear();
+  Location curLoc = targetLoc;
+  for (int d = dist; d > 0; d--)
   {
-    path.push_front(curLoc);
-    curLoc = visitedFrom[curLoc];
+    path->push_front(toIndex(curLoc));
+
+    const DirectionOrder &randSteps = randomDirectionOrder();
+    for (Direction step : randSteps)
+    {
+      Location prevLoc = {curLoc.x + step.x, curLoc.y + step.y};
+      if (!isInMazeBounds(prevLoc))
+      {
+        continue;
+      }
+
+      int prevWord = prevLoc.y * wordsPerRow + prevLoc.x / Grid::WordBits;
+      if (_visitedWordStamps[prevWord] == _searchStamp && _searchVisited.get(prevLoc.x, prevLoc.y) && _searchDists[toIndex(prevLoc)] == d - 1)
+      {
+        curLoc = prevLoc;
+        break;
+      }
+    }
   }
 
-  return path;
+  return true;
 }
 
-bool MazeRunner::isWall(int x, int y)
+// shortest path by following the distance field of endLoc downhill. Small mazes compute whole fields,
+// larger ones only compute a bounded query's field out to maxSteps, so a miss costs about as much as
+// the bounded search it replaces and later queries toward the same cell are served from the cache.
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::findPathToward(Location startLoc, Location endLoc, int maxSteps, Path *path)
 {
-  return _mazeWalls[y][x];
+  if (startLoc == NullLocation || endLoc == NullLocation)
+  {
+    return false;
+  }
+
+  const uint16_t *field = _distanceFields.find(toIndex(endLoc), maxSteps);
+  if (field == nullptr && path == nullptr)
+  {
+    // distances are symmetric, so the start's field answers "within N steps" just as well
+    field = _distanceFields.find(toIndex(startLoc), maxSteps);
+    if (field != nullptr)
+    {
+      int dist = field[toIndex(endLoc)];
+      return dist != FieldCache::Unreachable && (maxSteps <= 0 || dist <= maxSteps);
+    }
+  }
+
+  if (field == nullptr)
+  {
+    field = addDistanceField(endLoc, maxSteps);
+  }
+
+  int dist = field[toIndex(startLoc)];
+  if (dist == FieldCache::Unreachable || (maxSteps > 0 && dist > maxSteps))
+  {
+    return false;
+  }
+
+  if (path != nullptr)
+  {
+    path->clear();
+    Location curLoc = startLoc;
+    for (int d = dist; d > 0; d--)
+    {
+      const DirectionOrder &randSteps = randomDirectionOrder();
+      for (Direction step : randSteps)
+      {
+        Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
+        if (isInMazeBounds(nextLoc) && field[toIndex(nextLoc)] == d - 1)
+        {
+          curLoc = nextLoc;
+          break;
+        }
+      }
+      path->push_back(toIndex(curLoc));
+    }
+  }
+
+  return true;
 }
 
-bool MazeRunner::isWall(Location loc)
+// cached field of sourceLoc reaching at least maxSteps, computed on a miss
+template <int Width, int Height, typename Renderer>
+const uint16_t *MazeRunnerEngine<Width, Height, Renderer>::getDistanceField(Location sourceLoc, int maxSteps)
 {
-  return isWall(loc.x, loc.y);
+  const uint16_t *field = _distanceFields.find(toIndex(sourceLoc), maxSteps);
+  return field != nullptr ? field : addDistanceField(sourceLoc, maxSteps);
 }
 
-bool MazeRunner::isInMazeBounds(int x, int y)
+// Computes the field of sourceLoc into the least recently used slot. On large mazes a bounded one
+// reaches the longer of the two sense radii, so the field computed when an agent moves answers both
+// the runners' and the sentries' sensing of it and the sentries' paths toward it.
+template <int Width, int Height, typename Renderer>
+const uint16_t *MazeRunnerEngine<Width, Height, Renderer>::addDistanceField(Location sourceLoc, int maxSteps)
 {
-  return x >= 0 && x < _width && y >= 0 && y < _height;
+  int sourceIndex = toIndex(sourceLoc);
+  int senseRadius = std::max(_config.runnerSense, _config.sentrySense);
+  int radius = width() * height() <= AllPairsMaxCells || maxSteps <= 0 ? 0 : std::max(maxSteps, senseRadius);
+  int evictedSource;
+  uint16_t *field = _distanceFields.insert(sourceIndex, radius, &evictedSource);
+  if (evictedSource >= 0)
+  {
+    eraseDistanceField(evictedSource, field);
+  }
+  computeDistanceField(sourceIndex, radius, field);
+  return field;
 }
 
-bool MazeRunner::isInMazeBounds(Location loc)
+// BFS distances from sourceIndex out to radius steps, 0 for all of the maze. Expects every cell of
+// dists to be Unreachable and only writes the cells it reaches.
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::computeDistanceField(int sourceIndex, int radius, uint16_t *dists)
 {
-  return isInMazeBounds(loc.x, loc.y);
+  int queueHead = 0;
+  int queueTail = 0;
+  _searchCells[queueTail++] = sourceIndex;
+  dists[sourceIndex] = 0;
+
+  while (queueHead < queueTail)
+  {
+    int curIndex = _searchCells[queueHead++];
+    MAZE_PROFILE_NODES(_profiler, 1);
+    if (radius > 0 && dists[curIndex] >= radius)
+    {
+      continue;
+    }
+
+    Location curLoc = toLocation(curIndex);
+    for (Direction step : Directions)
+    {
+      Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
+      if (!isInMazeBounds(nextLoc) || isWall(nextLoc))
+      {
+        continue;
+      }
+
+      int nextIndex = toIndex(nextLoc);
+      if (dists[nextIndex] == FieldCache::Unreachable)
+      {
+        dists[nextIndex] = dists[curIndex] + 1;
+        _searchCells[queueTail++] = nextIndex;
+      }
+    }
+  }
 }
 
-int MazeRunner::getAdjacentWallAndBorderCount(int x, int y)
+// resets the cells a field from sourceIndex wrote back to Unreachable. They form a connected region
+// around the source, so a flood over reached cells finds them all, even after the walls changed.
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::eraseDistanceField(int sourceIndex, uint16_t *dists)
 {
-  int count = 0;
-  for (int i = 0; i < 4; i++)
+  int queueHead = 0;
+  int queueTail = 0;
+  _searchCells[queueTail++] = sourceIndex;
+  dists[sourceIndex] = FieldCache::Unreachable;
+
+  while (queueHead < queueTail)
   {
-    int nx = x + Directions[i].x;
-    int ny = y + Directions[i].y;
-    if (nx < 0 || nx >= _width || ny < 0 || ny >= _height || _mazeWalls[ny][nx])
+    Location curLoc = toLocation(_searchCells[queueHead++]);
+    for (Direction step : Directions)
     {
-      count++;
+      Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
+      if (!isInMazeBounds(nextLoc))
+      {
+        continue;
+      }
+
+      int nextIndex = toIndex(nextLoc);
+      if (dists[nextIndex] != FieldCache::Unreachable)
+      {
+        dists[nextIndex] = FieldCache::Unreachable;
+        _searchCells[queueTail++] = nextIndex;
+      }
     }
   }
-  return count;
 }
 
-int MazeRunner::getAdjacentWallAndBorderCount(Location loc)
+// Same as findNearestOccupied() for the cells of agents firstAgent to endAgent - 1, whose counts are
+// given, but reads each agent's distance from the cached field of where it stands. The search only
+// runs when more than one of their cells is in range and its visiting order picks the nearest.
+template <int Width, int Height, typename Renderer>
+int MazeRunnerEngine<Width, Height, Renderer>::senseNearestAgent(Location startLoc, int firstAgent, int endAgent,
+                                                                 const MazeBuffer<uint16_t, CellCount> &counts, int maxSteps)
 {
-  return getAdjacentWallAndBorderCount(loc.x, loc.y);
+  int startIndex = toIndex(startLoc);
+  int foundIndex = -1;
+  for (int agent = firstAgent; agent < endAgent; agent++)
+  {
+    Location agentLoc = _agentLocs[agent];
+    if (agentLoc == NullLocation || toIndex(agentLoc) == foundIndex)
+    {
+      continue;
+    }
+
+    int dist = getDistanceField(agentLoc, maxSteps)[startIndex];
+    if (dist == FieldCache::Unreachable || dist > maxSteps)
+    {
+      continue;
+    }
+    if (foundIndex >= 0)
+    {
+      return findNearestOccupied(startLoc, counts, maxSteps);
+    }
+    foundIndex = toIndex(agentLoc);
+  }
+  return foundIndex;
 }
 
-void MazeRunner::shuffleDirections(Direction *list, int size)
+// index of the nearest open cell within maxSteps of startLoc with a nonzero count, -1 if there is none
+template <int Width, int Height, typename Renderer>
+int MazeRunnerEngine<Width, Height, Renderer>::findNearestOccupied(Location startLoc, const MazeBuffer<uint16_t, CellCount> &counts, int maxSteps)
 {
-  for (int i = 0; i < size; i++)
+  beginSearch();
+
+  int queueHead = 0;
+  int queueTail = 0;
+  int startIndex = toIndex(startLoc);
+  markVisited(startIndex);
+  _searchCells[queueTail] = startIndex;
+  _searchDists[queueTail++] = 0;
+
+  while (queueHead < queueTail)
   {
-    int index = random(size);
-    Direction temp = list[i];
-    list[i] = list[index];
-    list[index] = temp;
+    int curIndex = _searchCells[queueHead];
+    int curDist = _searchDists[queueHead++];
+    MAZE_PROFILE_NODES(_profiler, 1);
+    if (counts[curIndex] > 0)
+    {
+      return curIndex;
+    }
+    if (curDist >= maxSteps)
+    {
+      continue;
+    }
+
+    Location curLoc = toLocation(curIndex);
+    for (Direction step : Directions)
+    {
+      Location nextLoc = {curLoc.x + step.x, curLoc.y + step.y};
+      if (!isInMazeBounds(nextLoc) || isWall(nextLoc))
+      {
+        continue;
+      }
+
+      int nextIndex = toIndex(nextLoc);
+      if (!isVisited(nextIndex))
+      {
+        markVisited(nextIndex);
+        _searchCells[queueTail] = nextIndex;
+        _searchDists[queueTail++] = curDist + 1;
+      }
+    }
   }
-}
\ No newline at end of file
+
+  return -1;
+}
+
+template <int Width, int Height, typename Renderer>
+void MazeRunnerEngine<Width, Height, Renderer>::beginSearch()
+{
+  // stamps wrapped, clear stale marks so they can't match the new stamp
+  if (++_searchStamp == 0)
+  {
+    memset(_visitedStamps.data(), 0, width() * height() * sizeof(uint16_t));
+    memset(_visitedWordStamps.data(), 0, _mazeWalls.wordsPerRow() * height() * sizeof(uint16_t));
+    _searchStamp = 1;
+  }
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::isWall(int x, int y)
+{
+  return _mazeWalls.get(x, y);
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::isWall(Location loc)
+{
+  return isWall(loc.x, loc.y);
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::isInMazeBounds(int x, int y)
+{
+  return x >= 0 && x < width() && y >= 0 && y < height();
+}
+
+template <int Width, int Height, typename Renderer>
+bool MazeRunnerEngine<Width, Height, Renderer>::isInMazeBounds(Location loc)
+{
+  return isInMazeBounds(loc.x, loc.y);
+}
+
+// renders through std::function callbacks, for mazes whose size is only known at runtime
+class CallbackRenderer
+{
+private:
+  std::function<void(int, int, uint32_t)> _drawPixel;
+  std::function<void(uint32_t)> _setStatus;
+
+public:
+  CallbackRenderer(std::function<void(int, int, uint32_t)> drawPixel, std::function<void(uint32_t)> setStatus)
+      : _drawPixel(drawPixel), _setStatus(setStatus) {}
+
+  void drawPixel(int x, int y, uint32_t color) { _drawPixel(x, y, color); }
+
+  void setStatus(uint32_t color)
+  {
+    if (_setStatus)
+    {
+      _setStatus(color);
+    }
+  }
+};
+
+class MazeRunner : public MazeRunnerEngine<DynamicSize, DynamicSize, CallbackRenderer>
+{
+public:
+  MazeRunner(
+      int width, int height,
+      uint32_t pathColor, uint32_t wallColor,
+      uint32_t runnerColor, uint32_t sentryColor,
+      uint32_t exitColor,
+      std::function<void(int, int, uint32_t)> drawPixel,
+      std::function<void(uint32_t)> setStatus = nullptr,
+      int runnerCount = 1, int sentryCount = 1)
+      : MazeRunnerEngine(width, height, pathColor, wallColor, runnerColor, sentryColor, exitColor, CallbackRenderer(drawPixel, setStatus), runnerCount, sentryCount) {}
+};
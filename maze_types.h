@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+using namespace std;
+
+struct Coordinate
+{
+  int x;
+  int y;
+};
+
+bool operator==(const Coordinate &lhs, const Coordinate &rhs)
+{
+  return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+bool operator!=(const Coordinate &lhs, const Coordinate &rhs)
+{
+  return !(lhs == rhs);
+}
+
+namespace std
+{
+  template <>
+  struct hash<Coordinate>
+  {
+    size_t operator()(const Coordinate &loc) const
+    {
+      return hash<int>()(loc.x) ^ hash<int>()(loc.y);
+    }
+  };
+}
+
+using Location = Coordinate;
+using Direction = Coordinate;
+
+const Location NullLocation = Location{-1, -1};
+
+const Direction Left = {-1, 0};
+const Direction Right = {1, 0};
+const Direction Up = {0, -1};
+const Direction Down = {0, 1};
+const Direction Directions[] = {Left, Right, Up, Down};
+
+// all 24 orderings of Directions, so a random order costs a single draw
+using DirectionOrder = Direction[4];
+const DirectionOrder DirectionOrders[24] = {
+    {Left, Right, Up, Down},
+    {Left, Right, Down, Up},
+    {Left, Up, Right, Down},
+    {Left, Up, Down, Right},
+    {Left, Down, Right, Up},
+    {Left, Down, Up, Right},
+    {Right, Left, Up, Down},
+    {Right, Left, Down, Up},
+    {Right, Up, Left, Down},
+    {Right, Up, Down, Left},
+    {Right, Down, Left, Up},
+    {Right, Down, Up, Left},
+    {Up, Left, Right, Down},
+    {Up, Left, Down, Right},
+    {Up, Right, Left, Down},
+    {Up, Right, Down, Left},
+    {Up, Down, Left, Right},
+    {Up, Down, Right, Left},
+    {Down, Left, Right, Up},
+    {Down, Left, Up, Right},
+    {Down, Right, Left, Up},
+    {Down, Right, Up, Left},
+    {Down, Up, Left, Right},
+    {Down, Up, Right, Left}};
@@ -0,0 +1,39 @@
+#pragma once
+
+// Counts global heap allocations so host tools can check which code paths allocate.
+// Replaces the global operator new/delete, so include from exactly one translation unit per program.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_counter
+{
+  inline std::atomic<uint64_t> &allocations()
+  {
+    static std::atomic<uint64_t> count{0};
+    return count;
+  }
+
+  inline uint64_t count() { return allocations().load(std::memory_order_relaxed); }
+}
+
+void *operator new(size_t size)
+{
+  alloc_counter::allocations().fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = malloc(size ? size : 1))
+  {
+    return ptr;
+  }
+#if __cpp_exceptions
+  throw std::bad_alloc();
+#else
+  abort();
+#endif
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
@@ -0,0 +1,16 @@
+// Runs the firmware's setup()/loop() on the host, against the shims in native/shim.
+
+#include <Arduino.h>
+
+void setup();
+void loop();
+
+int main()
+{
+  setup();
+  while (true)
+  {
+    loop();
+    delay(1);
+  }
+}
@@ -0,0 +1,114 @@
+// Headless batch simulation: plays many independent seeded mazes in parallel on a work-stealing
+// thread pool and reports how the games ended and how long they took.
+//
+// usage: maze_runner_batch [instances] [games] [width] [height] [threads] [seed] [csv]
+//   instances  independent mazes, instance i is seeded with seed + i
+//   games      games played by each instance
+//   threads    worker threads, 0 for one per core
+//   csv        optional file to write one instance,seed,game,outcome,ticks line per game
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "simulation.h"
+#include "work_stealing_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct OutcomeStats
+{
+  long games = 0;
+  uint64_t totalTicks = 0;
+  uint32_t minTicks = UINT32_MAX;
+  uint32_t maxTicks = 0;
+};
+
+int main(int argc, char **argv)
+{
+  int instances = argc > 1 ? atoi(argv[1]) : 1000;
+  int games = argc > 2 ? atoi(argv[2]) : 10;
+  int width = argc > 3 ? atoi(argv[3]) : 7;
+  int height = argc > 4 ? atoi(argv[4]) : 7;
+  int threads = argc > 5 ? atoi(argv[5]) : 0;
+  uint64_t seed = argc > 6 ? strtoull(argv[6], nullptr, 10) : 1;
+  const char *csvPath = argc > 7 ? argv[7] : nullptr;
+
+  if (instances <= 0 || games <= 0 || width < 3 || height < 3 || threads < 0)
+  {
+    fprintf(stderr, "usage: %s [instances>0] [games>0] [width>=3] [height>=3] [threads>=0] [seed] [csv]\n", argv[0]);
+    return 1;
+  }
+
+  // each task owns its slice of records and its own update count, so workers share nothing
+  vector<GameRecord> records(instances * games);
+  vector<uint64_t> updates(instances);
+
+  Clock::time_point start = Clock::now();
+  int threadCount;
+  {
+    WorkStealingPool pool(threads);
+    threadCount = pool.threadCount();
+    for (int i = 0; i < instances; i++)
+    {
+      pool.submit([&, i]
+                  { updates[i] = playGames(width, height, MazeRunnerConfig(), seed + i, games, &records[i * games]); });
+    }
+    pool.wait();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  OutcomeStats stats[OutcomeCount];
+  for (const GameRecord &record : records)
+  {
+    OutcomeStats &s = stats[record.outcome];
+    s.games++;
+    s.totalTicks += record.ticks;
+    s.minTicks = min(s.minTicks, record.ticks);
+    s.maxTicks = max(s.maxTicks, record.ticks);
+  }
+
+  uint64_t totalUpdates = 0;
+  for (uint64_t u : updates)
+  {
+    totalUpdates += u;
+  }
+
+  long totalGames = (long)records.size();
+  printf("maze %dx%d, %d instances x %d games, seed %llu, %d threads\n",
+         width, height, instances, games, (unsigned long long)seed, threadCount);
+  for (int o = 0; o < OutcomeCount; o++)
+  {
+    const OutcomeStats &s = stats[o];
+    if (s.games == 0)
+    {
+      printf("%-8s %8ld games (%5.1f%%)\n", OutcomeNames[o], s.games, 0.0);
+      continue;
+    }
+    printf("%-8s %8ld games (%5.1f%%), ticks mean %.1f, min %u, max %u\n", OutcomeNames[o], s.games,
+           100.0 * s.games / totalGames, (double)s.totalTicks / s.games, s.minTicks, s.maxTicks);
+  }
+  printf("%ld games in %.3f s, %.0f games/sec, %.0f ticks/sec (%.0f per thread)\n", totalGames, seconds,
+         totalGames / seconds, totalUpdates / seconds, totalUpdates / seconds / threadCount);
+
+  if (csvPath != nullptr)
+  {
+    FILE *csv = fopen(csvPath, "w");
+    if (csv == nullptr)
+    {
+      fprintf(stderr, "failed to open %s\n", csvPath);
+      return 1;
+    }
+    fprintf(csv, "instance,seed,game,outcome,ticks\n");
+    for (int i = 0; i < instances; i++)
+    {
+      for (int g = 0; g < games; g++)
+      {
+        const GameRecord &record = records[i * games + g];
+        fprintf(csv, "%d,%llu,%d,%s,%u\n", i, (unsigned long long)(seed + i), g, OutcomeNames[record.outcome], record.ticks);
+      }
+    }
+    fclose(csv);
+  }
+  return 0;
+}
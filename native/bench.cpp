@@ -0,0 +1,214 @@
+// Headless MazeRunner benchmark: times maze generation and full-speed update() ticks on the host,
+// and the slowest update() with the next maze built in update() or on a worker thread.
+//
+// usage: maze_runner_bench [width] [height] [ticks] [mazes] [seed] [runners] [sentries] [flow] [profile.json]
+//   flow     1 to have sentries chase along flow fields (MazeRunnerConfig::sentryFlowField)
+//   profile  built with MAZE_PROFILING (maze_runner_profile), where to write the full-speed run's profile,
+//            default MAZE_PROFILE_PATH, which CMake points into the build directory
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "../maze_runner_lib.h"
+#include "alloc_counter.h"
+
+#ifndef MAZE_PROFILE_PATH
+#define MAZE_PROFILE_PATH "maze_profile.json"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// printf() into a file, for MazeProfiler output
+struct FileOut
+{
+  FILE *file;
+
+  template <typename... Args>
+  int printf(const char *format, Args... args) { return fprintf(file, format, args...); }
+};
+
+static double elapsedUs(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// inlinable renderer for the compile-time sized engine
+struct CountingRenderer
+{
+  uint32_t *pixelsDrawn;
+  uint32_t *gamesFinished;
+
+  void drawPixel(int x, int y, uint32_t c) { (*pixelsDrawn)++; }
+  void setStatus(uint32_t c) { (*gamesFinished)++; }
+};
+
+// runs the same simulation on the MazeRunnerEngine<7, 7> specialization used by the 7x7 panel
+static void benchFixed7x7(long ticks, uint64_t seed)
+{
+  uint32_t pixelsDrawn = 0;
+  uint32_t gamesFinished = 0;
+  MazeRunnerEngine<7, 7, CountingRenderer> mazeRunner(7, 7, 0, 1, 2, 3, 4, CountingRenderer{&pixelsDrawn, &gamesFinished});
+  mazeRunner.setSeed(seed);
+  mazeRunner.init();
+
+  long frames = 0;
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < ticks; i++)
+  {
+    frames += mazeRunner.update() ? 1 : 0;
+  }
+  double tickUs = elapsedUs(start, Clock::now());
+
+  printf("fixed:  %ld ticks in %.1f ms, %.0f ticks/sec, %.3f us/tick (MazeRunnerEngine<7, 7>, %d bytes)\n",
+         ticks, tickUs / 1000, ticks / (tickUs / 1e6), tickUs / ticks, (int)sizeof(mazeRunner));
+}
+
+// Worst update() time while a reset is pending, which includes building the next maze unless
+// background is set, when a worker thread builds it during the delay as on the ESP32's idle core.
+// Frames of the reset delay are 1 ms apart, as they are tens of ms apart on the panel, so the worker
+// has time to finish.
+static void benchResetHitch(int width, int height, const MazeRunnerConfig &config, long ticks, uint64_t seed,
+                            int runners, int sentries, bool background)
+{
+  MazeRunner mazeRunner(width, height, 0, 1, 2, 3, 4, [](int x, int y, uint32_t c) {}, nullptr, runners, sentries);
+  mazeRunner.setConfig(config);
+  mazeRunner.setSeed(seed);
+  mazeRunner.init();
+
+  atomic<bool> done{false};
+  std::thread worker;
+  if (background)
+  {
+    worker = std::thread([&]
+                         {
+                           while (!done)
+                           {
+                             if (!mazeRunner.prepareNextMaze())
+                             {
+                               std::this_thread::yield();
+                             }
+                           } });
+  }
+
+  double maxUs = 0;
+  for (long i = 0; i < ticks; i++)
+  {
+    bool resetPending = mazeRunner.isResetPending();
+    Clock::time_point start = Clock::now();
+    mazeRunner.update();
+    if (resetPending)
+    {
+      maxUs = max(maxUs, elapsedUs(start, Clock::now()));
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  done = true;
+  if (worker.joinable())
+  {
+    worker.join();
+  }
+
+  printf("        slowest reset frame %.2f us with the next maze built %s, %u games finished\n", maxUs,
+         background ? "on a worker thread" : "in update()", mazeRunner.getGamesFinished());
+}
+
+int main(int argc, char **argv)
+{
+  int width = argc > 1 ? atoi(argv[1]) : 7;
+  int height = argc > 2 ? atoi(argv[2]) : 7;
+  long ticks = argc > 3 ? atol(argv[3]) : 1000000;
+  int mazes = argc > 4 ? atoi(argv[4]) : 1000;
+  uint64_t seed = argc > 5 ? strtoull(argv[5], nullptr, 10) : 1;
+  int runners = argc > 6 ? atoi(argv[6]) : 1;
+  int sentries = argc > 7 ? atoi(argv[7]) : 1;
+  MazeRunnerConfig config;
+  config.sentryFlowField = argc > 8 && atoi(argv[8]) != 0;
+
+  if (width < 3 || height < 3 || ticks <= 0 || mazes <= 0 || runners < 1 || sentries < 0)
+  {
+    fprintf(stderr, "usage: %s [width>=3] [height>=3] [ticks>0] [mazes>0] [seed] [runners>=1] [sentries>=0] [flow]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t pixelsDrawn = 0;
+  uint32_t gamesFinished = 0;
+  auto drawPixel = [&](int x, int y, uint32_t c)
+  { pixelsDrawn++; };
+  auto setStatus = [&](uint32_t c)
+  { gamesFinished++; };
+
+  // maze generation, runner/sentry/exit placement, on a fresh instance each time
+  double minInitUs = 1e30, maxInitUs = 0, totalInitUs = 0;
+  for (int i = 0; i < mazes; i++)
+  {
+    MazeRunner mazeRunner(width, height, 0, 1, 2, 3, 4, drawPixel, setStatus, runners, sentries);
+    mazeRunner.setConfig(config);
+    mazeRunner.setSeed(seed + i);
+    Clock::time_point start = Clock::now();
+    mazeRunner.init();
+    double us = elapsedUs(start, Clock::now());
+    minInitUs = min(minInitUs, us);
+    maxInitUs = max(maxInitUs, us);
+    totalInitUs += us;
+  }
+
+  // full-speed simulation, including resets between games
+  MazeRunner mazeRunner(width, height, 0, 1, 2, 3, 4, drawPixel, setStatus, runners, sentries);
+  mazeRunner.setConfig(config);
+  mazeRunner.setSeed(seed);
+  mazeRunner.init();
+  gamesFinished = 0;
+  pixelsDrawn = 0;
+#if MAZE_PROFILING
+  mazeRunner.profiler().reset();
+#endif
+  long frames = 0;
+  uint64_t allocsBefore = alloc_counter::count();
+  uint32_t fieldHitsBefore = mazeRunner.getDistanceFieldHits();
+  uint32_t fieldLookupsBefore = mazeRunner.getDistanceFieldLookups();
+  Clock::time_point start = Clock::now();
+  for (long i = 0; i < ticks; i++)
+  {
+    frames += mazeRunner.update() ? 1 : 0;
+  }
+  double tickUs = elapsedUs(start, Clock::now());
+  uint64_t tickAllocs = alloc_counter::count() - allocsBefore;
+  uint32_t fieldHits = mazeRunner.getDistanceFieldHits() - fieldHitsBefore;
+  uint32_t fieldLookups = mazeRunner.getDistanceFieldLookups() - fieldLookupsBefore;
+
+  printf("maze %dx%d, %d runners, %d sentries%s, seed %llu\n", width, height, runners, sentries,
+         config.sentryFlowField ? " on flow fields" : "", (unsigned long long)seed);
+  printf("init:   %d mazes, mean %.2f us, min %.2f us, max %.2f us\n", mazes, totalInitUs / mazes, minInitUs, maxInitUs);
+  printf("update: %ld ticks in %.1f ms, %.0f ticks/sec, %.3f us/tick\n", ticks, tickUs / 1000, ticks / (tickUs / 1e6), tickUs / ticks);
+  printf("        %ld frames drawn, %u pixels drawn, %u games finished\n", frames, pixelsDrawn, gamesFinished);
+  printf("        %llu heap allocations, %.4f per tick\n", (unsigned long long)tickAllocs, (double)tickAllocs / ticks);
+  printf("        %u of %u distance field lookups hit the cache\n", fieldHits, fieldLookups);
+
+#if MAZE_PROFILING
+  const char *profilePath = argc > 9 ? argv[9] : MAZE_PROFILE_PATH;
+  FileOut stdoutOut{stdout};
+  mazeRunner.profiler().printSummary(stdoutOut);
+  FILE *json = fopen(profilePath, "w");
+  if (json == nullptr)
+  {
+    fprintf(stderr, "failed to open %s\n", profilePath);
+    return 1;
+  }
+  FileOut jsonOut{json};
+  mazeRunner.profiler().printJson(jsonOut);
+  fclose(json);
+  printf("        profile written to %s\n", profilePath);
+#endif
+
+  long hitchTicks = max(1L, ticks / 10);
+  benchResetHitch(width, height, config, hitchTicks, seed, runners, sentries, false);
+  benchResetHitch(width, height, config, hitchTicks, seed, runners, sentries, true);
+
+  if (width == 7 && height == 7 && runners == 1 && sentries == 1 && !config.sentryFlowField)
+  {
+    benchFixed7x7(ticks, seed);
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Maze generator throughput: cells/sec for every generator over a range of square sizes, then
+// Eller's algorithm streaming an endless maze through two row buffers.
+//
+// usage: maze_runner_genbench [maxSize] [seed]
+
+#include <Arduino.h>
+
+#include "../bit_grid.h"
+#include "../maze_generators.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char *GeneratorNames[(int)MazeGenerator::Count] = {"carved-dfs", "growing-tree", "wilson", "eller", "chunked"};
+
+// enough repetitions per size for timings well above the clock resolution
+static const long MinCellsPerSize = 4000000;
+
+static void generate(MazeGenerator generator, BitGrid<> &walls, Location start, MazeRandom &random, int *scratch)
+{
+  switch (generator)
+  {
+  case MazeGenerator::GrowingTree:
+    GrowingTreeGenerator::generate(walls, start, random, scratch);
+    break;
+  case MazeGenerator::Wilson:
+    WilsonGenerator::generate(walls, start, random, scratch);
+    break;
+  case MazeGenerator::Eller:
+    EllerRowStream::generate(walls, start, random, scratch);
+    break;
+  case MazeGenerator::Chunked:
+    ChunkedGenerator::generate(walls, start, random, scratch);
+    break;
+  default:
+    CarvedDfsGenerator::generate(walls, start, random, scratch);
+    break;
+  }
+}
+
+// rows of a maze width cells wide and as long as rowCount, never holding more than two grid rows
+static void benchEllerStream(int width, long rowCount, MazeRandom &random)
+{
+  int words = (width + 31) / 32;
+  vector<uint32_t> cellRow(words), linkRow(words);
+  vector<int> state(EllerRowStream::stateSize(width));
+  EllerRowStream stream(width, 0, state.data());
+
+  uint64_t openCells = 0;
+  Clock::time_point start = Clock::now();
+  for (long row = 0; row < rowCount; row++)
+  {
+    stream.nextRows(random, cellRow.data(), linkRow.data(), row == rowCount - 1);
+    for (int w = 0; w < words; w++)
+    {
+      openCells += __builtin_popcount(~cellRow[w]) + __builtin_popcount(~linkRow[w]);
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  double cells = (double)width * rowCount * 2;
+  printf("eller stream %dx%ld: %.1f Mcells/sec, %d bytes of state, %.1f%% open\n", width, rowCount * 2,
+         cells / seconds / 1e6, (int)(state.size() * sizeof(int) + 2 * words * sizeof(uint32_t)),
+         100.0 * openCells / (words * 32.0 * rowCount * 2));
+}
+
+int main(int argc, char **argv)
+{
+  int maxSize = argc > 1 ? atoi(argv[1]) : 1024;
+  uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+  if (maxSize < 8)
+  {
+    fprintf(stderr, "usage: %s [maxSize>=8] [seed]\n", argv[0]);
+    return 1;
+  }
+
+  MazeRandom random(seed);
+  printf("%-14s", "size");
+  for (int g = 0; g < (int)MazeGenerator::Count; g++)
+  {
+    printf("%14s", GeneratorNames[g]);
+  }
+  printf("   (Mcells/sec)\n");
+
+  for (int size = 8; size <= maxSize; size *= 2)
+  {
+    BitGrid<> walls(size, size);
+    vector<int> scratch(size * size);
+    long reps = max(1L, MinCellsPerSize / (size * size));
+
+    printf("%-14s", (to_string(size) + "x" + to_string(size)).c_str());
+    for (int g = 0; g < (int)MazeGenerator::Count; g++)
+    {
+      double seconds = 0;
+      for (long rep = 0; rep < reps; rep++)
+      {
+        walls.fill(true);
+        Location start = {(int)random.uniform(size), (int)random.uniform(size)};
+        Clock::time_point begin = Clock::now();
+        generate((MazeGenerator)g, walls, start, random, scratch.data());
+        seconds += std::chrono::duration<double>(Clock::now() - begin).count();
+      }
+      printf("%14.1f", (double)size * size * reps / seconds / 1e6);
+    }
+    printf("\n");
+  }
+
+  benchEllerStream(maxSize, 100000, random);
+  return 0;
+}
@@ -0,0 +1,343 @@
+// Microbenchmarks of the engine's phases on seeded mazes from 7x7 up to 1024x1024: ns/op, nodes
+// expanded per second and heap allocations per op, written as JSON. Given a baseline JSON from an
+// earlier run, flags every benchmark that got slower by more than the threshold, or allocates more,
+// and exits with 1 if any did. Baselines are only comparable on the same machine and build.
+//
+// usage: maze_runner_microbench [--sizes 7,16,...,1024] [--min-ms 50] [--seed 1] [--out microbench.json]
+//                               [--baseline native/microbench_baseline.json] [--threshold 15]
+//   min-ms     time per trial, each result is the best of 5 trials
+//   threshold  percent slower than the baseline that counts as a regression
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../maze_runner_lib.h"
+#include "alloc_counter.h"
+
+using Clock = std::chrono::steady_clock;
+
+// keeps drawMaze() honest, a renderer that draws nothing lets the compiler drop the loop
+struct FrameRenderer
+{
+  uint32_t *pixels;
+  int width;
+
+  void drawPixel(int x, int y, uint32_t c) { pixels[y * width + x] = c; }
+  void setStatus(uint32_t c) {}
+};
+
+struct BenchResult
+{
+  string name;
+  double nsPerOp;
+  double nodesPerOp;
+  double allocsPerOp;
+  long ops;
+};
+
+static const int Trials = 5;
+static const int InputCount = 64;     // search endpoints per maze, used round robin
+static const int BoundedDistance = 12; // runner sense plus fear, how far a fleeing runner looks
+static const int PanelSize = 7;        // viewport of the 7x7 display
+
+// Runs op(i) with i counting up until a trial has taken minMs, or exactly fixedOps times, and keeps
+// the fastest trial. reset() runs before each trial, outside the timing.
+template <typename Op, typename Reset>
+static BenchResult measure(const string &name, double minMs, long fixedOps, Op op, Reset reset)
+{
+  BenchResult best = {name, 1e30, 0, 0, 0};
+  for (int trial = 0; trial < Trials; trial++)
+  {
+    reset();
+    uint64_t nodesBefore = mazeNodeCount();
+    uint64_t allocsBefore = alloc_counter::count();
+    Clock::time_point start = Clock::now();
+    long ops = 0;
+    double ns = 0;
+    for (long batch = 1; fixedOps > 0 ? ops < fixedOps : ns < minMs * 1e6; batch = min(batch * 2, 1024L))
+    {
+      for (long i = 0; i < batch && (fixedOps == 0 || ops < fixedOps); i++)
+      {
+        op(ops++);
+      }
+      ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    if (ns / ops < best.nsPerOp)
+    {
+      best.nsPerOp = ns / ops;
+      best.nodesPerOp = (double)(mazeNodeCount() - nodesBefore) / ops;
+      best.allocsPerOp = (double)(alloc_counter::count() - allocsBefore) / ops;
+      best.ops = ops;
+    }
+  }
+  return best;
+}
+
+class MazeMicroBench
+{
+public:
+  using Engine = MazeRunnerEngine<DynamicSize, DynamicSize, FrameRenderer>;
+
+  static void run(int size, uint64_t seed, double minMs, vector<BenchResult> &results);
+
+private:
+  static Location randomOpenCell(Engine &engine, MazeRandom &random);
+};
+
+Location MazeMicroBench::randomOpenCell(Engine &engine, MazeRandom &random)
+{
+  while (true)
+  {
+    Location loc = {(int)random.uniform(engine.width()), (int)random.uniform(engine.height())};
+    if (!engine._mazeWalls.get(loc.x, loc.y))
+    {
+      return loc;
+    }
+  }
+}
+
+void MazeMicroBench::run(int size, uint64_t seed, double minMs, vector<BenchResult> &results)
+{
+  string suffix = "/" + to_string(size) + "x" + to_string(size);
+  vector<uint32_t> pixels(size * size);
+  Engine engine(size, size, 0, 1, 2, 3, 4, FrameRenderer{pixels.data(), size});
+  engine.setSeed(seed);
+  engine.init();
+
+  MazeRandom random(seed);
+  Location starts[InputCount];
+  Location ends[InputCount];
+  for (int i = 0; i < InputCount; i++)
+  {
+    starts[i] = randomOpenCell(engine, random);
+    ends[i] = randomOpenCell(engine, random);
+  }
+  Engine::Path path;
+  path.allocate(size * size);
+  auto noReset = [] {};
+
+  results.push_back(measure("findPathDfs" + suffix, minMs, 0, [&](long i)
+                            {
+                              path.clear();
+                              engine.findPathDfs(starts[i % InputCount], ends[i % InputCount], -1, &path);
+                            },
+                            noReset));
+  results.push_back(measure("findPathDfsBounded" + suffix, minMs, 0, [&](long i)
+                            {
+                              path.clear();
+                              engine.findPathDfs(starts[i % InputCount], ends[i % InputCount], BoundedDistance, &path);
+                            },
+                            noReset));
+  results.push_back(measure("findLongestPathBfs" + suffix, minMs, 0, [&](long i)
+                            {
+                              path.clear();
+                              engine.findLongestPathBfs(starts[i % InputCount], ends[i % InputCount], BoundedDistance, &path);
+                            },
+                            noReset));
+  results.push_back(measure("drawMaze" + suffix, minMs, 0, [&](long i)
+                            {
+                              engine._fullRedraw = true;
+                              engine.drawMaze();
+                            },
+                            noReset));
+
+  // a panel sized view should cost the same at every maze size
+  engine.setViewport(PanelSize, PanelSize);
+  results.push_back(measure("drawViewport" + suffix, minMs, 0, [&](long i)
+                            {
+                              engine._fullRedraw = true;
+                              engine.drawMaze();
+                            },
+                            noReset));
+  engine.setViewport(size, size);
+
+  // into the next maze buffers, the current game is left alone
+  results.push_back(measure("generateMaze" + suffix, minMs, 0, [&](long i)
+                            { engine.generateMaze(); },
+                            noReset));
+  engine.buildNextMaze();
+  results.push_back(measure("placeExit" + suffix, minMs, 0, [&](long i)
+                            { engine.placeExit(); },
+                            noReset));
+
+  // a fixed run of ticks from the same start each trial, games and resets included, so results
+  // don't depend on how many ticks fit in the time
+  long ticks = max(1000L, 20000000L / (size * size));
+  results.push_back(measure("update" + suffix, minMs, ticks, [&](long i)
+                            { engine.update(); },
+                            [&]
+                            {
+                              engine.setSeed(seed);
+                              engine.init();
+                            }));
+}
+
+static void printResult(const BenchResult &result)
+{
+  printf("%-32s %12.1f %14.0f %12.1f %10.4f %10ld\n", result.name.c_str(), result.nsPerOp,
+         result.nodesPerOp * 1e9 / result.nsPerOp, result.nodesPerOp, result.allocsPerOp, result.ops);
+}
+
+static bool writeJson(const char *path, const vector<BenchResult> &results)
+{
+  FILE *file = fopen(path, "w");
+  if (!file)
+  {
+    return false;
+  }
+  // one benchmark per line, which is all readBaseline() parses
+  fprintf(file, "{\"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &result = results[i];
+    fprintf(file, "  {\"name\": \"%s\", \"ns_per_op\": %.2f, \"nodes_per_sec\": %.0f, \"nodes_per_op\": %.2f, \"allocs_per_op\": %.4f, \"ops\": %ld}%s\n",
+            result.name.c_str(), result.nsPerOp, result.nodesPerOp * 1e9 / result.nsPerOp, result.nodesPerOp, result.allocsPerOp,
+            result.ops, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "]}\n");
+  fclose(file);
+  return true;
+}
+
+static bool readBaseline(const char *path, map<string, BenchResult> &baseline)
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), file))
+  {
+    char name[128];
+    BenchResult result = {};
+    const char *allocs = strstr(line, "\"allocs_per_op\":");
+    if (sscanf(line, " {\"name\": \"%127[^\"]\", \"ns_per_op\": %lf", name, &result.nsPerOp) == 2 && allocs)
+    {
+      result.name = name;
+      sscanf(allocs, "\"allocs_per_op\": %lf", &result.allocsPerOp);
+      baseline[name] = result;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// returns the number of regressions
+static int compare(const vector<BenchResult> &results, const map<string, BenchResult> &baseline, double threshold)
+{
+  int regressions = 0;
+  printf("\n%-32s %12s %12s %8s\n", "vs baseline", "base ns/op", "ns/op", "change");
+  for (const BenchResult &result : results)
+  {
+    auto found = baseline.find(result.name);
+    if (found == baseline.end())
+    {
+      printf("%-32s %12s %12.1f %8s\n", result.name.c_str(), "-", result.nsPerOp, "new");
+      continue;
+    }
+
+    const BenchResult &base = found->second;
+    double change = 100.0 * (result.nsPerOp / base.nsPerOp - 1);
+    bool slower = change > threshold;
+    bool allocates = result.allocsPerOp > base.allocsPerOp + 0.001;
+    printf("%-32s %12.1f %12.1f %+7.1f%%%s%s\n", result.name.c_str(), base.nsPerOp, result.nsPerOp, change,
+           slower ? "  REGRESSION" : "", allocates ? "  MORE ALLOCATIONS" : "");
+    regressions += slower || allocates;
+  }
+  return regressions;
+}
+
+static bool parseSizes(const char *list, vector<int> &sizes)
+{
+  sizes.clear();
+  for (const char *p = list; *p;)
+  {
+    char *end;
+    long size = strtol(p, &end, 10);
+    if (end == p || size < 3)
+    {
+      return false;
+    }
+    sizes.push_back(size);
+    p = *end == ',' ? end + 1 : end;
+  }
+  return !sizes.empty();
+}
+
+int main(int argc, char **argv)
+{
+  vector<int> sizes = {7, 16, 32, 64, 128, 256, 512, 1024};
+  double minMs = 50;
+  uint64_t seed = 1;
+  const char *outPath = "microbench.json";
+  const char *baselinePath = nullptr;
+  double threshold = 15;
+
+  bool valid = argc % 2 == 1;
+  for (int i = 1; valid && i + 1 < argc; i += 2)
+  {
+    const char *option = argv[i];
+    const char *value = argv[i + 1];
+    if (strcmp(option, "--sizes") == 0)
+      valid = parseSizes(value, sizes);
+    else if (strcmp(option, "--min-ms") == 0)
+      valid = (minMs = atof(value)) > 0;
+    else if (strcmp(option, "--seed") == 0)
+      seed = strtoull(value, nullptr, 10);
+    else if (strcmp(option, "--out") == 0)
+      outPath = value;
+    else if (strcmp(option, "--baseline") == 0)
+      baselinePath = value;
+    else if (strcmp(option, "--threshold") == 0)
+      valid = (threshold = atof(value)) > 0;
+    else
+      valid = false;
+  }
+
+  if (!valid)
+  {
+    fprintf(stderr, "usage: %s [--sizes 7,16,...,1024] [--min-ms 50] [--seed 1] [--out microbench.json]\n"
+                    "       [--baseline file.json] [--threshold 15]\n",
+            argv[0]);
+    return 1;
+  }
+
+  map<string, BenchResult> baseline;
+  if (baselinePath && !readBaseline(baselinePath, baseline))
+  {
+    fprintf(stderr, "failed to read %s\n", baselinePath);
+    return 1;
+  }
+
+  printf("%-32s %12s %14s %12s %10s %10s\n", "benchmark", "ns/op", "nodes/sec", "nodes/op", "allocs/op", "ops");
+  vector<BenchResult> results;
+  for (int size : sizes)
+  {
+    size_t first = results.size();
+    MazeMicroBench::run(size, seed, minMs, results);
+    for (size_t i = first; i < results.size(); i++)
+    {
+      printResult(results[i]);
+    }
+  }
+
+  if (!writeJson(outPath, results))
+  {
+    fprintf(stderr, "failed to write %s\n", outPath);
+    return 1;
+  }
+  printf("results written to %s\n", outPath);
+
+  if (baselinePath)
+  {
+    int regressions = compare(results, baseline, threshold);
+    printf("%d regression%s beyond %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    return regressions > 0 ? 1 : 0;
+  }
+  return 0;
+}
@@ -0,0 +1,311 @@
+// Game recording and replay. record plays seeded games with the recorder on and writes the stream to
+// a file. verify re-drives the engine from each recording as fast as it can, skipping idle ticks,
+// re-encodes everything it does and checks it byte for byte against the file, so any difference in
+// moves, catches, outcomes, tick counts or the next maze is caught at the record where it starts.
+// Recordings are either binary or the hex a panel prints over Serial. A directory of them works as a
+// regression corpus and, with the ticks/sec printed, a benchmark.
+//
+// usage: maze_runner_replay record <file> [games] [width] [height] [seed] [flow]
+//        maze_runner_replay verify <file>...
+//   flow   1 for flow field sentries
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+using Clock = std::chrono::steady_clock;
+
+class FileRecordSink : public MazeRecordSink
+{
+private:
+  FILE *_file;
+
+public:
+  FileRecordSink(FILE *file) : _file(file) { fwrite(MazeRecordMagic, 1, sizeof(MazeRecordMagic), _file); }
+  void write(const uint8_t *data, int size) override { fwrite(data, 1, size, _file); }
+};
+
+// compares what the replay records against the original, stopping at the first difference
+class VerifyRecordSink : public MazeRecordSink
+{
+private:
+  const uint8_t *_expected;
+  int _size;
+  int _pos;
+  bool _matched = true;
+
+public:
+  VerifyRecordSink(const uint8_t *expected, int size, int pos) : _expected(expected), _size(size), _pos(pos) {}
+
+  void write(const uint8_t *data, int size) override
+  {
+    for (int i = 0; i < size && _matched; i++)
+    {
+      if (_pos >= _size || _expected[_pos] != data[i])
+      {
+        _matched = false;
+        return;
+      }
+      _pos++;
+    }
+  }
+
+  bool matched() const { return _matched; }
+  int position() const { return _pos; }
+};
+
+struct ReplayResult
+{
+  bool verified = false;
+  const char *error = nullptr;
+  int offset = 0; // where verification stopped
+  uint32_t games = 0;
+  uint64_t ticks = 0;
+};
+
+static bool readFile(const char *path, vector<uint8_t> &data)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+  {
+    return false;
+  }
+  uint8_t buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    data.insert(data.end(), buffer, buffer + count);
+  }
+  fclose(file);
+
+  if (MazeRecordReader::hasMagic(data.data(), data.size()))
+  {
+    return true;
+  }
+
+  // a hex dump from MazeRecordRing::printHex(), whitespace is ignored
+  vector<uint8_t> bytes;
+  string digits;
+  for (uint8_t c : data)
+  {
+    if (isxdigit(c))
+    {
+      digits += (char)c;
+    }
+    else if (!isspace(c))
+    {
+      return false;
+    }
+  }
+  for (size_t i = 0; i + 1 < digits.size(); i += 2)
+  {
+    bytes.push_back((uint8_t)stoul(digits.substr(i, 2), nullptr, 16));
+  }
+  data.swap(bytes);
+  return MazeRecordReader::hasMagic(data.data(), data.size());
+}
+
+// the keyframe after a Maze tag, agents included
+static bool readKeyframe(MazeRecordReader &reader, MazeKeyframe &keyframe, vector<Location> &agentLocs)
+{
+  if (!reader.readKeyframe(keyframe))
+  {
+    return false;
+  }
+  agentLocs.resize(keyframe.runnerCount + keyframe.sentryCount);
+  for (Location &loc : agentLocs)
+  {
+    if (!reader.readLocation(loc, keyframe.width))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// same as ticks update() calls
+static void runTicks(SimulatedMazeRunner &mazeRunner, uint32_t ticks)
+{
+  while (ticks > 0)
+  {
+    uint32_t idleTicks = min(mazeRunner.ticksUntilChange(), ticks);
+    if (idleTicks > 0)
+    {
+      mazeRunner.skipTicks(idleTicks);
+      ticks -= idleTicks;
+      continue;
+    }
+    mazeRunner.update();
+    ticks--;
+  }
+}
+
+// Starts from the first keyframe and then only feeds in what came from outside the engine: ticks,
+// config changes and restarts. Everything else has to come back out of the engine as recorded.
+static ReplayResult replay(const vector<uint8_t> &data)
+{
+  ReplayResult result;
+  MazeRecordReader reader(data.data(), data.size(), sizeof(MazeRecordMagic));
+  MazeKeyframe keyframe;
+  vector<Location> agentLocs;
+  uint8_t tag;
+  bool started = reader.readByte(tag) && (tag != MazeRecordRestart || reader.readByte(tag));
+  if (!started || tag != MazeRecordMaze || !readKeyframe(reader, keyframe, agentLocs))
+  {
+    result.error = "no keyframe at the start";
+    return result;
+  }
+
+  SimulatedMazeRunner mazeRunner(keyframe.width, keyframe.height, 0, 1, 2, 3, 4, NullRenderer{}, keyframe.runnerCount, keyframe.sentryCount);
+  mazeRunner.loadMaze(keyframe.config, keyframe.wallBits, keyframe.exitLoc, agentLocs.data(), keyframe.randomState);
+
+  VerifyRecordSink verifier(data.data(), data.size(), reader.position());
+  MazeRecorder recorder(verifier);
+  mazeRunner.setRecorder(&recorder);
+
+  while (!reader.atEnd() && verifier.matched() && !result.error)
+  {
+    reader.readByte(tag);
+    uint32_t ticks;
+    MazeRunnerConfig config;
+    switch (tag)
+    {
+    case MazeRecordTicks:
+      if (!reader.readVarint(ticks))
+      {
+        result.error = "truncated record";
+        break;
+      }
+      runTicks(mazeRunner, ticks);
+      result.ticks += ticks;
+      break;
+    case MazeRecordConfig:
+      if (!reader.readConfig(config))
+      {
+        result.error = "truncated record";
+        break;
+      }
+      mazeRunner.setConfig(config);
+      break;
+    case MazeRecordRestart:
+      if (!reader.readByte(tag) || tag != MazeRecordMaze || !readKeyframe(reader, keyframe, agentLocs))
+      {
+        result.error = "bad keyframe after restart";
+        break;
+      }
+      if (keyframe.width != mazeRunner.width() || keyframe.height != mazeRunner.height() ||
+          keyframe.runnerCount != mazeRunner.runnerCount() || keyframe.sentryCount != mazeRunner.sentryCount())
+      {
+        result.error = "restart with different dimensions";
+        break;
+      }
+      mazeRunner.loadMaze(keyframe.config, keyframe.wallBits, keyframe.exitLoc, agentLocs.data(), keyframe.randomState);
+      break;
+    case MazeRecordOutcome:
+      result.games++;
+      // fall through
+    default:
+      if (!reader.skipRecord(tag))
+      {
+        result.error = "truncated record";
+      }
+      break;
+    }
+  }
+  recorder.flush();
+
+  result.offset = verifier.position();
+  if (!result.error && !verifier.matched())
+  {
+    result.error = "replay diverged";
+  }
+  else if (!result.error && verifier.position() != (int)data.size())
+  {
+    result.error = "replay ended early";
+  }
+  result.verified = !result.error;
+  return result;
+}
+
+static int record(const char *path, int games, int width, int height, uint64_t seed, bool flow)
+{
+  FILE *file = fopen(path, "wb");
+  if (!file)
+  {
+    fprintf(stderr, "can't write %s\n", path);
+    return 1;
+  }
+
+  MazeRunnerConfig config;
+  config.sentryFlowField = flow;
+  vector<GameRecord> records(games);
+  FileRecordSink sink(file);
+  MazeRecorder recorder(sink);
+  uint64_t ticks = playGames(width, height, config, seed, games, records.data(), &recorder);
+  recorder.flush();
+  long size = ftell(file);
+  fclose(file);
+
+  printf("%s: %d games, %llu ticks, %ld bytes (%.1f per game)\n", path, games, (unsigned long long)ticks, size, (double)size / games);
+  return 0;
+}
+
+static int verify(int fileCount, char **paths)
+{
+  int failures = 0;
+  for (int i = 0; i < fileCount; i++)
+  {
+    vector<uint8_t> data;
+    if (!readFile(paths[i], data))
+    {
+      printf("%s: not a recording\n", paths[i]);
+      failures++;
+      continue;
+    }
+
+    Clock::time_point start = Clock::now();
+    ReplayResult result = replay(data);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (result.verified)
+    {
+      printf("%s: verified %u games, %llu ticks in %.3f s (%.0f ticks/sec)\n", paths[i], result.games,
+             (unsigned long long)result.ticks, seconds, result.ticks / seconds);
+    }
+    else
+    {
+      printf("%s: %s at byte %d, in game %u after %llu ticks\n", paths[i], result.error, result.offset, result.games + 1,
+             (unsigned long long)result.ticks);
+      failures++;
+    }
+  }
+  return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc >= 3 && strcmp(argv[1], "record") == 0)
+  {
+    int games = argc > 3 ? atoi(argv[3]) : 100;
+    int width = argc > 4 ? atoi(argv[4]) : 7;
+    int height = argc > 5 ? atoi(argv[5]) : 7;
+    uint64_t seed = argc > 6 ? strtoull(argv[6], nullptr, 10) : 1;
+    bool flow = argc > 7 && atoi(argv[7]) != 0;
+    if (games > 0 && width >= 3 && height >= 3)
+    {
+      return record(argv[2], games, width, height, seed, flow);
+    }
+  }
+  else if (argc >= 3 && strcmp(argv[1], "verify") == 0)
+  {
+    return verify(argc - 2, argv + 2);
+  }
+
+  fprintf(stderr, "usage: %s record <file> [games>0] [width>=3] [height>=3] [seed] [flow]\n"
+                  "       %s verify <file>...\n",
+          argv[0], argv[0]);
+  return 1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Host-side stand-in for Adafruit_NeoPixel: keeps the pixel buffer in memory and counts show() calls.
+
+#include <Arduino.h>
+#include <vector>
+
+class Adafruit_NeoPixel
+{
+private:
+  std::vector<uint32_t> _pixels;
+  uint8_t _brightness = 255;
+  uint32_t _showCount = 0;
+
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6) : _pixels(n, 0) {}
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+
+  void begin() {}
+  void show() { _showCount++; }
+  void clear() { std::fill(_pixels.begin(), _pixels.end(), 0); }
+  void setBrightness(uint8_t brightness) { _brightness = brightness; }
+  uint8_t getBrightness() const { return _brightness; }
+
+  void setPixelColor(uint16_t n, uint32_t c)
+  {
+    if (n < _pixels.size())
+    {
+      _pixels[n] = c;
+    }
+  }
+
+  uint32_t getPixelColor(uint16_t n) const { return n < _pixels.size() ? _pixels[n] : 0; }
+  uint16_t numPixels() const { return _pixels.size(); }
+  uint32_t getShowCount() const { return _showCount; }
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+// Minimal host-side stand-in for the Arduino-ESP32 core, covering only what the maze code uses:
+// random(), log_*(), String, timing and the few FreeRTOS task calls made by the display task handlers.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+
+// like the arduino-esp32 core
+using std::max;
+using std::min;
+
+// log levels match the arduino-esp32 core, set with -DCORE_DEBUG_LEVEL=n like on device
+#define ARDUHAL_LOG_LEVEL_NONE 0
+#define ARDUHAL_LOG_LEVEL_ERROR 1
+#define ARDUHAL_LOG_LEVEL_WARN 2
+#define ARDUHAL_LOG_LEVEL_INFO 3
+#define ARDUHAL_LOG_LEVEL_DEBUG 4
+#define ARDUHAL_LOG_LEVEL_VERBOSE 5
+
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL ARDUHAL_LOG_LEVEL_ERROR
+#endif
+#define ARDUHAL_LOG_LEVEL CORE_DEBUG_LEVEL
+
+#define ARDUHAL_LOG(level, letter, format, ...)                                                   \
+  do                                                                                              \
+  {                                                                                               \
+    if (ARDUHAL_LOG_LEVEL >= level)                                                               \
+    {                                                                                             \
+      fprintf(stderr, "[%c][%s:%d] " format "\n", letter, __func__, __LINE__, ##__VA_ARGS__); \
+    }                                                                                             \
+  } while (0)
+
+#define log_e(format, ...) ARDUHAL_LOG(ARDUHAL_LOG_LEVEL_ERROR, 'E', format, ##__VA_ARGS__)
+#define log_w(format, ...) ARDUHAL_LOG(ARDUHAL_LOG_LEVEL_WARN, 'W', format, ##__VA_ARGS__)
+#define log_i(format, ...) ARDUHAL_LOG(ARDUHAL_LOG_LEVEL_INFO, 'I', format, ##__VA_ARGS__)
+#define log_d(format, ...) ARDUHAL_LOG(ARDUHAL_LOG_LEVEL_DEBUG, 'D', format, ##__VA_ARGS__)
+#define log_v(format, ...) ARDUHAL_LOG(ARDUHAL_LOG_LEVEL_VERBOSE, 'V', format, ##__VA_ARGS__)
+
+#define OUTPUT 0x03
+#define INPUT 0x01
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+
+inline unsigned long micros()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+// splitmix64, stands in for the hardware RNG behind esp_random(), safe to call from any thread
+inline std::atomic<uint64_t> &shimRandomState()
+{
+  static std::atomic<uint64_t> state{0x9E3779B97F4A7C15ull};
+  return state;
+}
+
+inline void randomSeed(unsigned long seed) { shimRandomState() = seed; }
+
+inline uint32_t esp_random()
+{
+  uint64_t z = shimRandomState().fetch_add(0x9E3779B97F4A7C15ull) + 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return (uint32_t)(z ^ (z >> 31));
+}
+
+inline long random(long howbig)
+{
+  if (howbig <= 0)
+  {
+    return 0;
+  }
+  return esp_random() % howbig;
+}
+
+inline long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig)
+  {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+// Serial goes to stdout
+class HardwareSerial
+{
+public:
+  void begin(unsigned long baud) {}
+  int available() { return 0; } // no input on host
+  int read() { return -1; }
+  size_t write(const char *str) { return fputs(str, stdout) >= 0 ? strlen(str) : 0; }
+  size_t print(const char *str) { return write(str); }
+  size_t println(const char *str = "") { return write(str) + write("\n"); }
+
+  template <typename... Args>
+  size_t printf(const char *format, Args... args) { return ::printf(format, args...); }
+
+  void flush() { fflush(stdout); }
+};
+
+inline HardwareSerial Serial;
+
+class String
+{
+private:
+  std::string _buffer;
+
+public:
+  String() = default;
+  String(const char *str) : _buffer(str) {}
+
+  String &operator+=(char c)
+  {
+    _buffer += c;
+    return *this;
+  }
+
+  String &operator+=(const char *str)
+  {
+    _buffer += str;
+    return *this;
+  }
+
+  const char *c_str() const { return _buffer.c_str(); }
+  unsigned int length() const { return _buffer.length(); }
+};
+
+// FreeRTOS task API, backed by detached std::threads
+typedef std::thread *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+inline int xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                   unsigned int priority, TaskHandle_t *handle, int coreId)
+{
+  TaskHandle_t thread = new std::thread(task, parameters);
+  thread->detach();
+  if (handle != nullptr)
+  {
+    *handle = thread;
+  }
+  return 1;
+}
+
+// FreeRTOS ticks, 1 ms like the arduino-esp32 default CONFIG_FREERTOS_HZ=1000
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+// sleeps until *previousWakeTime + timeIncrement and advances *previousWakeTime by the increment,
+// returning at once if that time has already passed
+inline void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t timeIncrement)
+{
+  *previousWakeTime += timeIncrement;
+  int32_t remaining = (int32_t)(*previousWakeTime - xTaskGetTickCount());
+  if (remaining > 0)
+  {
+    delay(remaining);
+  }
+}
+
+inline void vTaskSuspend(TaskHandle_t handle)
+{
+  log_w("vTaskSuspend is not supported on host");
+}
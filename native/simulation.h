@@ -0,0 +1,92 @@
+#pragma once
+
+// Shared pieces of the headless simulation tools: a renderer that draws nothing and a loop that
+// plays seeded games back to back on one engine instance.
+
+#include <Arduino.h>
+
+#include "../maze_runner_lib.h"
+
+// games still running after this many ticks are abandoned as stalled
+static const uint32_t MaxGameTicks = 100000;
+
+// nothing to draw, outcomes are read back from the engine
+struct NullRenderer
+{
+  void drawPixel(int x, int y, uint32_t c) {}
+  void setStatus(uint32_t c) {}
+};
+
+using SimulatedMazeRunner = MazeRunnerEngine<DynamicSize, DynamicSize, NullRenderer>;
+
+enum SimOutcome : uint8_t
+{
+  ReachedExit,
+  Caught,
+  Error,
+  Stalled,
+  OutcomeCount
+};
+
+inline constexpr const char *OutcomeNames[OutcomeCount] = {"exit", "caught", "error", "stalled"};
+
+struct GameRecord
+{
+  uint8_t outcome;
+  uint32_t ticks; // update() calls from init() to the end of the game
+};
+
+// plays games back to back on one instance, writing a record per game, returns ticks played
+inline uint64_t playGames(int width, int height, const MazeRunnerConfig &config, uint64_t seed, int games, GameRecord *records,
+                          MazeRecorder *recorder = nullptr)
+{
+  SimulatedMazeRunner mazeRunner(width, height, 0, 1, 2, 3, 4, NullRenderer{});
+  mazeRunner.setConfig(config);
+  mazeRunner.setRecorder(recorder);
+  mazeRunner.setSeed(seed);
+  mazeRunner.init();
+
+  uint64_t updates = 0;
+  for (int game = 0; game < games; game++)
+  {
+    uint32_t finished = mazeRunner.getGamesFinished();
+    uint32_t ticks = 0;
+    while (mazeRunner.getGamesFinished() == finished && ticks < MaxGameTicks)
+    {
+      // cooldowns and reset delays are skipped in one go rather than ticked through
+      uint32_t idleTicks = min(mazeRunner.ticksUntilChange(), MaxGameTicks - ticks);
+      if (idleTicks > 0)
+      {
+        mazeRunner.skipTicks(idleTicks);
+        ticks += idleTicks;
+        continue;
+      }
+      mazeRunner.update();
+      ticks++;
+    }
+    updates += ticks;
+
+    GameRecord &record = records[game];
+    if (mazeRunner.getGamesFinished() == finished)
+    {
+      record = {Stalled, ticks};
+      mazeRunner.init();
+      continue;
+    }
+
+    switch (mazeRunner.getLastOutcome())
+    {
+    case GameOutcome::ReachedExit:
+      record.outcome = ReachedExit;
+      break;
+    case GameOutcome::Caught:
+      record.outcome = Caught;
+      break;
+    default:
+      record.outcome = Error;
+      break;
+    }
+    record.ticks = mazeRunner.getLastGameTicks();
+  }
+  return updates;
+}
@@ -0,0 +1,269 @@
+// Parameter sweep: plays many seeded games for every combination of runner/sentry settings and maze
+// size, in parallel, and appends one CSV line of win rates and game lengths per combination.
+// Combinations already in the output file are skipped, so extending a grid only runs the new points.
+//
+// usage: maze_runner_sweep [--fear 10] [--sense 2] [--speed 3] [--sentry-sense 2] [--sentry-speed 5]
+//                          [--size 7x7] [--games 1000] [--seed 1] [--threads 0] [--out sweep.csv]
+// every setting takes a comma separated list of values, e.g. --sense 1,2,3 --size 7x7,16x16
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+#include "work_stealing_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+// games of one point played back to back on one instance, task b of every point is seeded with seed + b
+static const int GamesPerTask = 100;
+
+// leading CSV columns, which together identify a point
+static const char *KeyHeader = "width,height,runner_fear,runner_sense,runner_speed,sentry_sense,sentry_speed,games,seed";
+static const int KeyColumns = 9;
+
+struct SweepPoint
+{
+  int width;
+  int height;
+  MazeRunnerConfig config;
+  string key;
+  vector<GameRecord> records;
+  atomic<int> tasksLeft{0};
+};
+
+static bool parseList(const char *arg, vector<int> &values)
+{
+  values.clear();
+  for (const char *p = arg; *p != '\0';)
+  {
+    char *end;
+    long value = strtol(p, &end, 10);
+    if (end == p || value < 0 || value > 255)
+    {
+      return false;
+    }
+    values.push_back((int)value);
+    p = *end == ',' ? end + 1 : end;
+    if (*end != ',' && *end != '\0')
+    {
+      return false;
+    }
+  }
+  return !values.empty();
+}
+
+static bool parseSizes(const char *arg, vector<pair<int, int>> &sizes)
+{
+  sizes.clear();
+  for (const char *p = arg; *p != '\0';)
+  {
+    int width, height, length;
+    if (sscanf(p, "%dx%d%n", &width, &height, &length) != 2 || width < 3 || height < 3)
+    {
+      return false;
+    }
+    sizes.push_back({width, height});
+    p += length;
+    if (*p == ',')
+    {
+      p++;
+    }
+    else if (*p != '\0')
+    {
+      return false;
+    }
+  }
+  return !sizes.empty();
+}
+
+static string makeKey(int width, int height, const MazeRunnerConfig &config, int games, uint64_t seed)
+{
+  char key[128];
+  snprintf(key, sizeof(key), "%d,%d,%d,%d,%d,%d,%d,%d,%llu", width, height, config.runnerFear, config.runnerSense,
+           config.runnerSpeed, config.sentrySense, config.sentrySpeed, games, (unsigned long long)seed);
+  return key;
+}
+
+// keys of the points already in the output file, returns false if the file doesn't exist yet
+static bool loadCachedKeys(const char *path, set<string> &keys)
+{
+  FILE *csv = fopen(path, "r");
+  if (csv == nullptr)
+  {
+    return false;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), csv) != nullptr)
+  {
+    int commas = 0;
+    char *p = line;
+    while (*p != '\0' && *p != '\n' && !(*p == ',' && ++commas == KeyColumns))
+    {
+      p++;
+    }
+    if (commas == KeyColumns)
+    {
+      keys.insert(string(line, p - line));
+    }
+  }
+  fclose(csv);
+  return true;
+}
+
+static void writePoint(FILE *csv, const SweepPoint &point)
+{
+  long counts[OutcomeCount] = {};
+  uint64_t ticks[OutcomeCount] = {};
+  for (const GameRecord &record : point.records)
+  {
+    counts[record.outcome]++;
+    ticks[record.outcome] += record.ticks;
+  }
+
+  double games = point.records.size();
+  fprintf(csv, "%s,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f\n", point.key.c_str(),
+          counts[ReachedExit] / games, counts[Caught] / games, counts[Error] / games, counts[Stalled] / games,
+          counts[ReachedExit] > 0 ? (double)ticks[ReachedExit] / counts[ReachedExit] : 0.0,
+          counts[Caught] > 0 ? (double)ticks[Caught] / counts[Caught] : 0.0);
+  fflush(csv);
+}
+
+int main(int argc, char **argv)
+{
+  vector<int> fears = {10}, senses = {2}, speeds = {3}, sentrySenses = {2}, sentrySpeeds = {5};
+  vector<pair<int, int>> sizes = {{7, 7}};
+  int games = 1000;
+  uint64_t seed = 1;
+  int threads = 0;
+  const char *outPath = "sweep.csv";
+
+  bool valid = argc % 2 == 1;
+  for (int i = 1; valid && i + 1 < argc; i += 2)
+  {
+    const char *option = argv[i];
+    const char *value = argv[i + 1];
+    if (strcmp(option, "--fear") == 0)
+      valid = parseList(value, fears);
+    else if (strcmp(option, "--sense") == 0)
+      valid = parseList(value, senses);
+    else if (strcmp(option, "--speed") == 0)
+      valid = parseList(value, speeds);
+    else if (strcmp(option, "--sentry-sense") == 0)
+      valid = parseList(value, sentrySenses);
+    else if (strcmp(option, "--sentry-speed") == 0)
+      valid = parseList(value, sentrySpeeds);
+    else if (strcmp(option, "--size") == 0)
+      valid = parseSizes(value, sizes);
+    else if (strcmp(option, "--games") == 0)
+      valid = (games = atoi(value)) > 0;
+    else if (strcmp(option, "--seed") == 0)
+      seed = strtoull(value, nullptr, 10);
+    else if (strcmp(option, "--threads") == 0)
+      valid = (threads = atoi(value)) >= 0;
+    else if (strcmp(option, "--out") == 0)
+      outPath = value;
+    else
+      valid = false;
+  }
+
+  if (!valid)
+  {
+    fprintf(stderr, "usage: %s [--fear 10] [--sense 2] [--speed 3] [--sentry-sense 2] [--sentry-speed 5]\n"
+                    "       [--size 7x7] [--games 1000] [--seed 1] [--threads 0] [--out sweep.csv]\n"
+                    "settings take comma separated lists of values\n",
+            argv[0]);
+    return 1;
+  }
+
+  set<string> cachedKeys;
+  bool outExists = loadCachedKeys(outPath, cachedKeys);
+
+  // every combination not already in the output file
+  vector<unique_ptr<SweepPoint>> points;
+  int cachedPoints = 0;
+  for (const pair<int, int> &size : sizes)
+    for (int fear : fears)
+      for (int sense : senses)
+        for (int speed : speeds)
+          for (int sentrySense : sentrySenses)
+            for (int sentrySpeed : sentrySpeeds)
+            {
+              MazeRunnerConfig config;
+              config.runnerFear = fear;
+              config.runnerSense = sense;
+              config.runnerSpeed = speed;
+              config.sentrySense = sentrySense;
+              config.sentrySpeed = sentrySpeed;
+              string key = makeKey(size.first, size.second, config, games, seed);
+              if (cachedKeys.count(key) > 0)
+              {
+                cachedPoints++;
+                continue;
+              }
+
+              SweepPoint *point = new SweepPoint();
+              point->width = size.first;
+              point->height = size.second;
+              point->config = config;
+              point->key = key;
+              point->records.resize(games);
+              points.emplace_back(point);
+              cachedKeys.insert(key); // repeated values on the command line only run once
+            }
+
+  FILE *csv = fopen(outPath, "a");
+  if (csv == nullptr)
+  {
+    fprintf(stderr, "failed to open %s\n", outPath);
+    return 1;
+  }
+  if (!outExists)
+  {
+    fprintf(csv, "%s,exit_rate,caught_rate,error_rate,stalled_rate,mean_ticks_to_exit,mean_ticks_to_catch\n", KeyHeader);
+  }
+
+  // points are appended as their last task finishes, so an interrupted sweep keeps what it finished
+  mutex csvMutex;
+  int pointsDone = 0;
+  Clock::time_point start = Clock::now();
+  {
+    WorkStealingPool pool(threads);
+    printf("%d points to run, %d cached, %d games each, %d threads\n", (int)points.size(), cachedPoints, games, pool.threadCount());
+
+    for (unique_ptr<SweepPoint> &pointPtr : points)
+    {
+      SweepPoint *point = pointPtr.get();
+      int tasks = (games + GamesPerTask - 1) / GamesPerTask;
+      point->tasksLeft = tasks;
+      for (int task = 0; task < tasks; task++)
+      {
+        pool.submit([&, point, task]
+                    {
+                      int first = task * GamesPerTask;
+                      int count = min(GamesPerTask, games - first);
+                      playGames(point->width, point->height, point->config, seed + task, count, &point->records[first]);
+
+                      if (--point->tasksLeft == 0)
+                      {
+                        lock_guard<mutex> lock(csvMutex);
+                        writePoint(csv, *point);
+                        vector<GameRecord>().swap(point->records);
+                        pointsDone++;
+                      }
+                    });
+      }
+    }
+    pool.wait();
+  }
+  fclose(csv);
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%d points written to %s in %.2f s\n", pointsDone, outPath, seconds);
+  return 0;
+}
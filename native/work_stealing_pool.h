@@ -0,0 +1,165 @@
+#pragma once
+
+// Fixed set of worker threads, each with its own task deque. A worker runs its newest task first and,
+// when its deque is empty, steals the oldest task of another worker, so uneven task lengths still
+// spread evenly over the cores.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+private:
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::thread> _threads;
+  std::atomic<int> _queued{0};  // tasks sitting in deques
+  std::atomic<int> _pending{0}; // tasks submitted but not finished
+  std::atomic<bool> _stopping{false};
+  int _nextWorker = 0;
+
+  std::mutex _sleepMutex;
+  std::condition_variable _workAvailable;
+  std::condition_variable _allDone;
+
+public:
+  // threadCount <= 0 uses one thread per hardware core
+  explicit WorkStealingPool(int threadCount = 0);
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+  ~WorkStealingPool();
+
+  int threadCount() const { return (int)_threads.size(); }
+
+  // not thread safe, submit from the owning thread only
+  void submit(std::function<void()> task);
+  // blocks until every submitted task has finished
+  void wait();
+
+private:
+  void run(int self);
+  bool takeTask(int self, std::function<void()> &task);
+};
+
+inline WorkStealingPool::WorkStealingPool(int threadCount)
+{
+  if (threadCount <= 0)
+  {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    _workers.emplace_back(new Worker());
+  }
+  for (int i = 0; i < threadCount; i++)
+  {
+    _threads.emplace_back(&WorkStealingPool::run, this, i);
+  }
+}
+
+inline WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _stopping = true;
+  }
+  _workAvailable.notify_all();
+  for (std::thread &thread : _threads)
+  {
+    thread.join();
+  }
+}
+
+// tasks are dealt round robin, stealing evens out whatever imbalance is left
+inline void WorkStealingPool::submit(std::function<void()> task)
+{
+  Worker &worker = *_workers[_nextWorker];
+  _nextWorker = (_nextWorker + 1) % (int)_workers.size();
+
+  _pending++;
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _queued++;
+  }
+  _workAvailable.notify_one();
+}
+
+inline void WorkStealingPool::wait()
+{
+  std::unique_lock<std::mutex> lock(_sleepMutex);
+  _allDone.wait(lock, [this]
+                { return _pending == 0; });
+}
+
+inline void WorkStealingPool::run(int self)
+{
+  std::function<void()> task;
+  while (true)
+  {
+    if (takeTask(self, task))
+    {
+      task();
+      task = nullptr;
+      if (--_pending == 0)
+      {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _allDone.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    _workAvailable.wait(lock, [this]
+                        { return _stopping || _queued > 0; });
+    if (_stopping && _queued == 0)
+    {
+      return;
+    }
+  }
+}
+
+// own deque from the back, then other deques from the front
+inline bool WorkStealingPool::takeTask(int self, std::function<void()> &task)
+{
+  int count = (int)_workers.size();
+  for (int i = 0; i < count; i++)
+  {
+    Worker &worker = *_workers[(self + i) % count];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+    {
+      continue;
+    }
+
+    if (i == 0)
+    {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    }
+    _queued--;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+// Lock-free queue for exactly one producer task and one consumer task. Items are copied in and out,
+// push() fails instead of blocking when the queue is full. Capacity must be a power of two.
+template <typename T, int Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    T _items[Capacity];
+    std::atomic<uint32_t> _head{0}; // next item to pop, only the consumer writes it
+    std::atomic<uint32_t> _tail{0}; // next slot to push, only the producer writes it
+
+public:
+    bool push(const T &item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        _items[tail & (Capacity - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = _items[head & (Capacity - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
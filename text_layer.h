@@ -0,0 +1,141 @@
+#pragma once
+#include <Arduino.h>
+
+enum class TextMode : uint8_t
+{
+    Overlay, // lit text pixels cover the maze, the rest shows through
+    Replace  // the whole matrix shows only the text
+};
+
+// 3x5 font for ASCII 32-95, three columns per glyph with bit 0 the top row. Lowercase is drawn as
+// uppercase and anything else as '?'.
+static const int FontGlyphWidth = 3;
+static const int FontGlyphHeight = 5;
+static const uint8_t Font3x5[] = {
+    0x00, 0x00, 0x00, 0x00, 0x17, 0x00, 0x03, 0x00, 0x03, 0x1F, 0x0A, 0x1F, 0x12, 0x1F, 0x09, 0x19, 0x04, 0x13, 0x0A, 0x15, 0x1A, 0x00, 0x03, 0x00, //  !"#$%&'
+    0x00, 0x0E, 0x11, 0x11, 0x0E, 0x00, 0x05, 0x02, 0x05, 0x04, 0x0E, 0x04, 0x10, 0x08, 0x00, 0x04, 0x04, 0x04, 0x00, 0x10, 0x00, 0x18, 0x04, 0x03, // ()*+,-./
+    0x1F, 0x11, 0x1F, 0x12, 0x1F, 0x10, 0x19, 0x15, 0x12, 0x11, 0x15, 0x0A, 0x07, 0x04, 0x1F, 0x17, 0x15, 0x09, 0x1E, 0x15, 0x1D, 0x01, 0x1D, 0x03, // 01234567
+    0x1F, 0x15, 0x1F, 0x17, 0x15, 0x0F, 0x00, 0x0A, 0x00, 0x10, 0x0A, 0x00, 0x04, 0x0A, 0x11, 0x0A, 0x0A, 0x0A, 0x11, 0x0A, 0x04, 0x01, 0x15, 0x02, // 89:;<=>?
+    0x0E, 0x15, 0x16, 0x1E, 0x05, 0x1E, 0x1F, 0x15, 0x0A, 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x0E, 0x1F, 0x15, 0x11, 0x1F, 0x05, 0x01, 0x0E, 0x11, 0x1D, // @ABCDEFG
+    0x1F, 0x04, 0x1F, 0x11, 0x1F, 0x11, 0x08, 0x10, 0x0F, 0x1F, 0x04, 0x1B, 0x1F, 0x10, 0x10, 0x1F, 0x06, 0x1F, 0x1F, 0x01, 0x1E, 0x0E, 0x11, 0x0E, // HIJKLMNO
+    0x1F, 0x05, 0x02, 0x0E, 0x19, 0x16, 0x1F, 0x05, 0x1A, 0x12, 0x15, 0x09, 0x01, 0x1F, 0x01, 0x1F, 0x10, 0x1F, 0x0F, 0x10, 0x0F, 0x1F, 0x0C, 0x1F, // PQRSTUVW
+    0x1B, 0x04, 0x1B, 0x03, 0x1C, 0x03, 0x19, 0x15, 0x13, 0x1F, 0x11, 0x00, 0x03, 0x04, 0x18, 0x00, 0x11, 0x1F, 0x02, 0x01, 0x02, 0x10, 0x10, 0x10, // XYZ[\]^_
+};
+
+// Scrolling text over a Width x Height matrix. setText() rasterizes the whole message once into a
+// cache of column bitmaps, led in by Width blank columns so it scrolls in from the right edge and all
+// the way off before repeating. Each frame then only compares the Width visible columns against what
+// is already on the matrix and emits the pixels that differ, so the per frame cost doesn't depend on
+// the message length.
+template <int Width, int Height, int MaxChars>
+class TextLayer
+{
+    static_assert(Height >= FontGlyphHeight && Height <= 32, "Text needs 5 to 32 rows");
+
+private:
+    static const int MaxColumns = Width + MaxChars * (FontGlyphWidth + 1);
+    static const int RowOffset = (Height - FontGlyphHeight) / 2; // text is centered vertically
+
+    uint32_t _columns[MaxColumns]; // one bit per row, already shifted to the text rows
+    int _columnCount = 0;          // zero when there is no text
+    int _scroll = 0;               // cache column shown at x = 0
+    uint32_t _shown[Width] = {};   // lit text pixels currently on the matrix
+    TextMode _mode = TextMode::Overlay;
+    int _framesPerColumn;
+    int _frame = 0;
+    bool _redrawAll = false; // every pixel's coverage may have changed
+
+public:
+    TextLayer(int framesPerColumn = 2) : _framesPerColumn(max(1, framesPerColumn)) {}
+
+    // empty text clears the layer
+    void setText(const char *text);
+    void setMode(TextMode mode)
+    {
+        _mode = mode;
+        _redrawAll = true;
+    }
+
+    bool isActive() const { return _columnCount > 0; }
+
+    // true if whatever is drawn under the text at (x, y) is hidden
+    bool covers(int x, int y) const
+    {
+        if (!isActive())
+        {
+            return false;
+        }
+        return _mode == TextMode::Replace || ((_shown[x] >> y) & 1);
+    }
+
+    // Scrolls when due and calls draw(x, y, lit) for every pixel that changed, or for every pixel
+    // after the text or mode changed. Unlit pixels show whatever covers() says is under them.
+    // Returns true if anything was drawn.
+    template <typename Draw>
+    bool update(Draw draw);
+};
+
+template <int Width, int Height, int MaxChars>
+void TextLayer<Width, Height, MaxChars>::setText(const char *text)
+{
+    int count = 0;
+    for (int x = 0; x < Width; x++)
+    {
+        _columns[count++] = 0;
+    }
+
+    for (int i = 0; i < MaxChars && text[i] != '\0'; i++)
+    {
+        char c = text[i];
+        c = c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+        c = c >= ' ' && c <= '_' ? c : '?';
+
+        const uint8_t *glyph = &Font3x5[(c - ' ') * FontGlyphWidth];
+        for (int x = 0; x < FontGlyphWidth; x++)
+        {
+            _columns[count++] = (uint32_t)glyph[x] << RowOffset;
+        }
+        _columns[count++] = 0; // spacing
+    }
+
+    _columnCount = count > Width ? count : 0;
+    _scroll = 0;
+    _frame = 0;
+    _redrawAll = true;
+}
+
+template <int Width, int Height, int MaxChars>
+template <typename Draw>
+bool TextLayer<Width, Height, MaxChars>::update(Draw draw)
+{
+    if (!isActive() && !_redrawAll)
+    {
+        return false;
+    }
+
+    if (isActive() && ++_frame >= _framesPerColumn)
+    {
+        _frame = 0;
+        _scroll = _scroll + 1 < _columnCount ? _scroll + 1 : 0;
+    }
+
+    bool drawn = false;
+    int column = _scroll;
+    for (int x = 0; x < Width; x++)
+    {
+        uint32_t lit = isActive() ? _columns[column] : 0;
+        column = column + 1 < _columnCount ? column + 1 : 0;
+
+        uint32_t changed = _redrawAll ? (1u << (Height - 1) << 1) - 1 : lit ^ _shown[x];
+        _shown[x] = lit;
+        for (; changed != 0; changed &= changed - 1)
+        {
+            int y = __builtin_ctz(changed);
+            draw(x, y, (lit >> y) & 1);
+            drawn = true;
+        }
+    }
+
+    _redrawAll = false;
+    return drawn;
+}